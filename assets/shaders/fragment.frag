@@ -1,5 +1,9 @@
 #version 450
 
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec3 fragPos;
@@ -7,6 +11,9 @@ layout(location = 3) in vec2 fragUV;
 
 layout(location = 0) out vec4 outColor;
 
+// variants, see ForwardVariant: SHADOWED, TEXTURED, IS_BLEND, DOUBLE_SIDED, BINDLESS
+layout(constant_id = 0) const int MAX_POINT_LIGHTS = 10;
+
 struct PointLight {
     vec3 position;
     float radius;
@@ -32,17 +39,29 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
+    uint materialIndex;
 } push;
 
-layout(set = 1, binding = 0) uniform sampler2D shadowMap;
-
 // material
-layout(set = 2, binding = 0) uniform Material {
+struct MaterialParams {
     vec4 base_color;
     float metallic;
     float roughness;
-} material;
-layout(set = 2, binding = 1) uniform sampler2D base_color_tex;
+    uint base_color_texture; // slot in textures, BINDLESS only
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Materials {
+    MaterialParams params[];
+} materials;
+
+layout(set = 1, binding = 0) uniform sampler2D shadowMap;
+
+#ifdef BINDLESS
+// every texture, indexed by the material
+layout(set = 2, binding = 0) uniform sampler2D textures[];
+#else
+layout(set = 2, binding = 0) uniform sampler2D base_color_tex;
+#endif
 
 const float PI = 3.14159265359;
 
@@ -165,20 +184,46 @@ float calcuShadow() {
 }
 
 void main(){
-    vec3 albedo = mix(texture(base_color_tex, fragUV).rgb, material.base_color.rgb, material.base_color.a);
+    MaterialParams material = materials.params[push.materialIndex];
+#ifdef TEXTURED
+#ifdef BINDLESS
+    // the index comes from a push constant, so it is uniform across the draw
+    vec4 baseColor = texture(textures[material.base_color_texture], fragUV);
+#else
+    vec4 baseColor = texture(base_color_tex, fragUV);
+#endif
+    vec3 albedo = mix(baseColor.rgb, material.base_color.rgb, material.base_color.a);
+    float alpha = baseColor.a;
+#else
+    // the default texture is transparent black
+    vec3 albedo = material.base_color.rgb * material.base_color.a;
+    float alpha = material.base_color.a;
+#endif
     float metallic = material.metallic;
     float roughness = material.roughness;
 
     vec3 N = normalize(fragNormal);
+#ifdef DOUBLE_SIDED
+    if (!gl_FrontFacing) N = -N;
+#endif
     vec3 V = normalize(ubo.inverseView[3].xyz - fragPos);
 
     vec3 lightColor = 0.03 * ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
-    for (int i = 0; i < ubo.numLights; i++) {
+    int numLights = min(ubo.numLights, MAX_POINT_LIGHTS);
+    for (int i = 0; i < numLights; i++) {
         lightColor += calcuPointLight(ubo.pointLights[i], albedo, metallic, roughness, N, V);
     }
 
+#ifdef SHADOWED
     float shadow = calcuShadow();
+#else
+    float shadow = 1;
+#endif
     lightColor += shadow * calcuDirectionalLight(albedo, metallic, roughness, N, V);
 
+#ifdef IS_BLEND
+    outColor = vec4(lightColor * fragColor, alpha);
+#else
     outColor = vec4(lightColor * fragColor, 1);
+#endif
 }
@@ -851,11 +851,11 @@ bool ImGui_CreateGraphicsPipeline()
 	PipelineCreateInfo.basePipelineHandle = NULL;
 	PipelineCreateInfo.basePipelineIndex = 0;
 
-	if (vkCreateGraphicsPipelines(ImGui_ImplVulkan_Renderer_Info.Device, NULL, 1, &PipelineCreateInfo, NULL, &ImGui_ImplVulkan_Renderer_Info.Pipeline) != VK_SUCCESS)
+	if (vkCreateGraphicsPipelines(ImGui_ImplVulkan_Renderer_Info.Device, ImGui_ImplVulkan_Renderer_Info.PipelineCache, 1, &PipelineCreateInfo, NULL, &ImGui_ImplVulkan_Renderer_Info.Pipeline) != VK_SUCCESS)
 		return ImGui_ImplVulkanPrintError("[ImGui Vulkan] Failed to Create Graphics Pipeline");
 
 	ColorBlendAttachmentState.blendEnable = VK_FALSE;
-	if (vkCreateGraphicsPipelines(ImGui_ImplVulkan_Renderer_Info.Device, NULL, 1, &PipelineCreateInfo, NULL, &ImGui_ImplVulkan_Renderer_Info.OpaquePipeline) != VK_SUCCESS)
+	if (vkCreateGraphicsPipelines(ImGui_ImplVulkan_Renderer_Info.Device, ImGui_ImplVulkan_Renderer_Info.PipelineCache, 1, &PipelineCreateInfo, NULL, &ImGui_ImplVulkan_Renderer_Info.OpaquePipeline) != VK_SUCCESS)
 		return ImGui_ImplVulkanPrintError("[ImGui Vulkan] Failed to Create Opaque Graphics Pipeline");
 
 	return 1;
@@ -870,6 +870,7 @@ void ImGui_ImplVulkan_Init(ImGui_ImplVulkan_InitInfo* InitInfo)
 	ImGui_ImplVulkan_Renderer_Info.PhysicalDevice = InitInfo->PhysicalDevice;
 	ImGui_ImplVulkan_Renderer_Info.ImageCount = InitInfo->ImageCount;
 	ImGui_ImplVulkan_Renderer_Info.MsaaSamples = InitInfo->MsaaSamples;
+	ImGui_ImplVulkan_Renderer_Info.PipelineCache = InitInfo->PipelineCache;
 	ImGui_ImplVulkan_Renderer_Info.LastPipeline = false;
 	ImGui_ImplVulkan_Renderer_Info.LastDescriptorSet = false;
 
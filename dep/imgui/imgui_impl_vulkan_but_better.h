@@ -8,6 +8,7 @@ typedef struct
 	VkPhysicalDevice PhysicalDevice;
 	uint32_t ImageCount;
 	VkSampleCountFlagBits MsaaSamples;
+	VkPipelineCache PipelineCache;
 } ImGui_ImplVulkan_InitInfo;
 
 typedef struct
@@ -28,6 +29,7 @@ struct
 	VkPhysicalDevice PhysicalDevice;
 	uint32_t ImageCount;
 	VkSampleCountFlagBits MsaaSamples;
+	VkPipelineCache PipelineCache;
 
 	VkPipeline Pipeline;
 	VkPipeline OpaquePipeline;
@@ -0,0 +1,381 @@
+//
+//  main.cpp
+//  nary_bench
+//
+//  Renders a generated scene headless for a fixed number of frames and writes the timings as JSON.
+//
+
+#include "se_tools.h"
+
+#include "RenderManager.hpp"
+#include "NullRenderManager.hpp"
+#include "naFrameBuffer.hpp"
+#include "naProfiler.hpp"
+#include "Scene.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// counts every allocation of the process, the frame loop reads the difference
+static std::atomic<uint64_t> s_Allocations{0};
+
+void* operator new(std::size_t size) {
+    s_Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete(void* p, std::size_t) noexcept {std::free(p);}
+
+namespace nary {
+
+VkSampleCountFlagBits naFrameBuffer::MsaaSamples = VK_SAMPLE_COUNT_1_BIT;
+
+struct BenchConfig {
+    uint32_t objects = 1000;
+    uint32_t depth = 1;          // length of the parent chains the objects are grouped in
+    uint32_t pointLights = 4;
+    uint32_t materials = 8;
+    float moving = 10;           // percentage of objects moved every frame
+    uint32_t frames = 300;
+    uint32_t warmup = 30;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t seed = 1;
+    std::string output = "bench.json";
+    std::string trace;           // optional Chrome trace of the measured frames
+    bool null = false;           // use the null backend, no Vulkan device is created
+    uint32_t meshUploads = 0;    // meshes created before the frames to time their upload
+    bool stagedUploads = false;  // upload them through the staging buffer even if they could be written in place
+};
+
+struct FrameSample {
+    double ms;
+    uint64_t allocations;
+};
+
+static void printUsage() {
+    std::cout << "usage: nary_bench [--objects N] [--depth N] [--point-lights N] [--materials N] [--moving PERCENT]\n"
+                 "                  [--frames N] [--warmup N] [--width N] [--height N] [--seed N]\n"
+                 "                  [--output FILE] [--trace FILE] [--null] [--mesh-uploads N] [--staged-uploads]\n";
+}
+
+static bool parseArgs(int argc, const char* argv[], BenchConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") return false;
+        if (arg == "--null") {
+            config.null = true;
+            continue;
+        }
+        if (arg == "--staged-uploads") {
+            config.stagedUploads = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            ERROR_LOG("missing value for {}", arg);
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--objects") config.objects = std::stoul(value);
+        else if (arg == "--depth") config.depth = std::max(1ul, std::stoul(value));
+        else if (arg == "--point-lights") config.pointLights = std::stoul(value);
+        else if (arg == "--materials") config.materials = std::max(1ul, std::stoul(value));
+        else if (arg == "--moving") config.moving = std::clamp(std::stof(value), 0.f, 100.f);
+        else if (arg == "--frames") config.frames = std::max(1ul, std::stoul(value));
+        else if (arg == "--warmup") config.warmup = std::stoul(value);
+        else if (arg == "--width") config.width = std::stoul(value);
+        else if (arg == "--height") config.height = std::stoul(value);
+        else if (arg == "--seed") config.seed = std::stoul(value);
+        else if (arg == "--output") config.output = value;
+        else if (arg == "--trace") config.trace = value;
+        else if (arg == "--mesh-uploads") config.meshUploads = std::stoul(value);
+        else {
+            ERROR_LOG("unknown option {}", arg);
+            return false;
+        }
+    }
+
+    if (config.pointLights > MAX_NUM_POINT_LIGHTS) {
+        WARNING_LOG("at most {} point lights are supported", MAX_NUM_POINT_LIGHTS);
+        config.pointLights = MAX_NUM_POINT_LIGHTS;
+    }
+    return true;
+}
+
+class Bench {
+public:
+    Bench(const BenchConfig& config)
+    : config(config), rng(config.seed) {
+        if (config.null)
+            nullRenderManager = std::make_unique<NullRenderManager>();
+        else
+            renderManager = std::make_unique<RenderManager>(VkExtent2D{config.width, config.height});
+        buildScene();
+        uploadMeshes();
+    }
+
+    void run() {
+        LOOP (config.warmup) frame(i);
+
+        naProfiler::beginCapture(config.frames, config.trace);
+        LOOP (config.frames) {
+            auto allocations = s_Allocations.load(std::memory_order_relaxed);
+            auto begin = std::chrono::steady_clock::now();
+
+            frame(config.warmup + i);
+            NARY_PROFILE_FRAME();
+
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back({
+                std::chrono::duration<double, std::milli>(end - begin).count(),
+                s_Allocations.load(std::memory_order_relaxed) - allocations
+            });
+        }
+    }
+
+    void writeReport() const {
+        std::ofstream file{config.output};
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + config.output);
+        }
+
+        auto ms = frameTimes();
+        double allocations = 0;
+        for (auto& s : samples) allocations += s.allocations;
+        allocations /= samples.size();
+
+        file << "{\n";
+        file << "  \"config\": {"
+             << "\"objects\": " << config.objects
+             << ", \"depth\": " << config.depth
+             << ", \"point_lights\": " << config.pointLights
+             << ", \"materials\": " << config.materials
+             << ", \"moving_percent\": " << config.moving
+             << ", \"frames\": " << config.frames
+             << ", \"warmup\": " << config.warmup
+             << ", \"width\": " << config.width
+             << ", \"height\": " << config.height
+             << ", \"seed\": " << config.seed
+             << ", \"backend\": \"" << (config.null ? "null" : "vulkan") << "\"},\n";
+        file << "  \"profiler_enabled\": " << (NARY_PROFILE ? "true" : "false") << ",\n";
+        file << "  \"frame_ms\": {"
+             << "\"mean\": " << mean(ms)
+             << ", \"p50\": " << percentile(ms, .5)
+             << ", \"p95\": " << percentile(ms, .95)
+             << ", \"p99\": " << percentile(ms, .99)
+             << ", \"max\": " << ms.back() << "},\n";
+        file << "  \"allocations_per_frame\": " << allocations << ",\n";
+        if (meshUploadMs >= 0) {
+            file << "  \"mesh_upload\": {"
+                 << "\"meshes\": " << config.meshUploads
+                 << ", \"path\": \"" << uploadPath << "\""
+                 << ", \"ms\": " << meshUploadMs << "},\n";
+        }
+
+        if (nullRenderManager) {
+            // counters include the warmup frames
+            auto& c = nullRenderManager->getTotalCounters();
+            double frames = static_cast<double>(nullRenderManager->getFrameCount());
+            file << "  \"draws_per_frame\": {"
+                 << "\"draw_calls\": " << c.drawCalls / frames
+                 << ", \"material_binds\": " << c.materialBinds / frames
+                 << ", \"pipeline_binds\": " << c.pipelineBinds / frames
+                 << ", \"vertices\": " << c.vertices / frames
+                 << ", \"shadow\": " << c.passDrawCalls[0] / frames
+                 << ", \"forward\": " << c.passDrawCalls[1] / frames << "},\n";
+        }
+
+        // zone totals are averaged over the measured frames, a zone can run several times per frame
+        file << "  \"stages\": [";
+        auto stats = naProfiler::getCaptureStats();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            auto& s = stats[i];
+            file << (i ? ",\n" : "\n")
+                 << "    {\"name\": \"" << s.name << "\""
+                 << ", \"calls_per_frame\": " << static_cast<double>(s.count) / config.frames
+                 << ", \"ms_per_frame\": " << s.totalNs * 1e-6 / config.frames
+                 << ", \"max_ms\": " << s.maxNs * 1e-6 << "}";
+        }
+        file << "\n  ]\n}\n";
+
+        INFO_LOG("mean frame {} ms, p95 {} ms, {} allocations per frame, report written to {}",
+                 mean(ms), percentile(ms, .95), allocations, config.output);
+    }
+
+private:
+    void buildScene() {
+        auto resource = getRenderResource();
+
+        std::uniform_real_distribution<float> unit{0.f, 1.f};
+        std::vector<AssetRef> materials;
+        LOOP (config.materials) {
+            Material material{};
+            material.baseColorFactor = {unit(rng), unit(rng), unit(rng), 1.f};
+            material.metallicFactor = unit(rng);
+            material.roughnessFactor = unit(rng);
+            materials.push_back(resource->addMaterial(material));
+        }
+
+        // objects fill a box in front of the camera, children are offset from their parents
+        constexpr float extent = 20.f;
+        std::uniform_real_distribution<float> pos{-extent, extent};
+        naGameObject::id_t parent = 0;
+        LOOP (config.objects) {
+            auto obj = naGameObject::createGameObject();
+            obj.addComponent<MeshComponent>(); // the default cube, no files needed
+            obj.addComponent<MaterialComponent>(materials[i % materials.size()]);
+            obj.transform().scale = mathpls::vec3{.2f};
+
+            naGameObject::id_t id;
+            if (i % config.depth == 0) {
+                obj.transform().translation = {pos(rng), pos(rng) * .5f, pos(rng) + extent + 2.f};
+                id = scene.addGameObject(std::move(obj));
+            } else {
+                obj.transform().translation = {1.f, 0, 0};
+                id = scene.addGameObject(std::move(obj), parent);
+            }
+            parent = id;
+
+            if (unit(rng) * 100 < config.moving)
+                movingObjects.push_back(id);
+        }
+
+        LOOP (config.pointLights) {
+            auto light = naGameObject::createPointLight(.1f, mathpls::vec3{unit(rng), unit(rng), unit(rng)} * 10.f);
+            light.transform().translation = {pos(rng), -2.f, pos(rng) + extent + 2.f};
+            scene.addGameObject(std::move(light));
+        }
+
+        auto sun = naGameObject::createGameObject();
+        auto dl = sun.addComponent<DirectionalLightComponent>();
+        dl->direction = {-0.522f, -0.42f, -0.492f};
+        dl->color = {1.f, 1.f, 1.f};
+        scene.addGameObject(std::move(sun));
+
+        auto camera = std::make_unique<naCamera>();
+        auto aspect = static_cast<float>(config.width) / static_cast<float>(config.height);
+        camera->setPerspectiveProjection(mathpls::radians(60.f), aspect, .1f, 100.f);
+        camera->transform().rotation.y = mathpls::pi<float>();
+        scene.SetActiveCamera(std::move(camera));
+    }
+
+    void uploadMeshes() {
+        auto device = getRenderResource()->getDevice();
+        if (!device || config.meshUploads == 0) return;
+        if (config.stagedUploads)
+            device->disableDirectUploads();
+        uploadPath = device->directUploads() ? "direct" : "staged";
+
+        // a flat grid, the same mesh every time
+        constexpr uint32_t size = 64;
+        naModel::Builder builder;
+        LOOP (size * size) {
+            naModel::Vertex vertex{};
+            vertex.position = {static_cast<float>(i % size), 0, static_cast<float>(i / size)};
+            vertex.normal = {0, 1, 0};
+            builder.vertices.push_back(vertex);
+        }
+        for (uint32_t y = 0; y + 1 < size; ++y)
+            for (uint32_t x = 0; x + 1 < size; ++x)
+                for (uint32_t i : {0u, size, 1u, 1u, size, size + 1})
+                    builder.indices.push_back(y * size + x + i);
+
+        // until every mesh is resident, a staged mesh is when its copy finished
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<naModel>> meshes;
+        UploadTicket last = 0;
+        LOOP (config.meshUploads) {
+            meshes.push_back(std::make_unique<naModel>(*device, builder));
+            last = std::max(last, meshes.back()->getUploadTicket());
+        }
+        device->uploader().wait(last);
+        meshUploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        INFO_LOG("{} meshes uploaded {} in {} ms", config.meshUploads, uploadPath, meshUploadMs);
+    }
+
+    void frame(uint32_t index) {
+        // deterministic motion so every run renders the same frames
+        float t = index / 60.f;
+        for (auto id : movingObjects) {
+            auto& transform = scene.getGameObject(id)->transform();
+            transform.rotation.y = t + id * .1f;
+            transform.translation.y += std::sin(t + id) * .01f;
+        }
+
+        scene.Update();
+        if (nullRenderManager)
+            nullRenderManager->tick(scene);
+        else
+            renderManager->tick(scene);
+    }
+
+    RenderResource* getRenderResource() const {
+        return nullRenderManager ? nullRenderManager->getRenderResource() : renderManager->getRenderResource();
+    }
+
+    std::vector<double> frameTimes() const {
+        std::vector<double> ms;
+        for (auto& s : samples) ms.push_back(s.ms);
+        std::sort(ms.begin(), ms.end());
+        return ms;
+    }
+
+    static double mean(const std::vector<double>& v) {
+        double sum = 0;
+        for (auto i : v) sum += i;
+        return sum / v.size();
+    }
+
+    static double percentile(const std::vector<double>& sorted, double p) {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+    }
+
+    BenchConfig config;
+
+    std::unique_ptr<RenderManager> renderManager;
+    std::unique_ptr<NullRenderManager> nullRenderManager;
+    Scene scene;
+
+    std::mt19937 rng;
+    std::vector<naGameObject::id_t> movingObjects;
+    std::vector<FrameSample> samples;
+    double meshUploadMs = -1;
+    const char* uploadPath = "";
+};
+
+}
+
+int main(int argc, const char* argv[]) {
+    nary::BenchConfig config;
+    if (!nary::parseArgs(argc, argv, config)) {
+        nary::printUsage();
+        return 1;
+    }
+
+#if !NARY_PROFILE
+    WARNING_LOG("profiler zones are compiled out, only frame times are reported (configure with -DNARY_ENABLE_PROFILER=ON)");
+#endif
+
+    try {
+        nary::Bench bench{config};
+        bench.run();
+        bench.writeReport();
+    } catch (const std::exception& e) {
+        ERROR_LOG("{}", e.what());
+        return 1;
+    }
+    return 0;
+}
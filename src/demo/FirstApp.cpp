@@ -13,6 +13,7 @@
 #include "naFrameBuffer.hpp"
 
 #include "scene_loader.hpp"
+#include "naProfiler.hpp"
 
 namespace nary {
 
@@ -42,6 +43,7 @@ void FirstApp::run(){
 
         scene.Update();
 
+        assetManager.update();
         renderManager.tick(scene);
         DrawUI();
         
@@ -51,6 +53,8 @@ void FirstApp::run(){
         } // process window resizing
         
         UpdatePhysics();
+
+        NARY_PROFILE_FRAME();
         
 #ifndef NDEBUG
         ++frameCount;
@@ -81,7 +85,7 @@ void FirstApp::DrawUI() {
             ImGui::DragFloat("Metallic", &mat.metallicFactor, 0.01f, 0.f, 1.f);
             ImGui::DragFloat("Roughness", &mat.roughnessFactor, 0.01f, 0.f, 1.f);
             if (ImGui::Button("Update"))
-                renderManager.getRenderResource()->updateMaterialDescriptorSet(i.first);
+                renderManager.getRenderResource()->updateMaterial(i.first);
             ImGui::PopID();
         }
 
@@ -97,17 +101,11 @@ FirstApp::FirstApp(){
     initEvents();
 }
 
-FirstApp::~FirstApp() {
-#ifndef NDEBUG
-    ShaderCompiler::DeleteAllCaches();
-#endif // on debuging, delete shader caches
-}
-
 void FirstApp::loadGameObjects(){
 //    std::shared_ptr<naModel> model0 = naModel::createModelFromFile(device, "smooth_vase.obj");
 //    std::shared_ptr<naModel> model1 = naModel::createModelFromFile(device, "flat_vase.obj");
 //    std::shared_ptr<naModel> model2 = naModel::createModelFromFile(device, "quad.obj");
-    auto quad_id = assetManager.loadModel("quad.obj");
+    auto quad_id = assetManager.loadModelAsync("quad.obj").id;
 
 //    auto smooth_vase = naGameObject::createGameObject();
 //    smooth_vase.model = model0;
@@ -121,7 +119,7 @@ void FirstApp::loadGameObjects(){
 //    flat_vase.transform.scale = {3.5f, 1.5f, 3.5f};
 //    flat_vase.color = {.45f, .3f, .1f};
 
-    auto floor_tex_id = assetManager.loadImage("floor.jpg");
+    auto floor_tex_id = assetManager.loadImageAsync("floor.jpg").id;
     Material floor_material{};
     floor_material.baseColorFactor.a = 0.f;
     floor_material.base_color_texture = floor_tex_id;
@@ -139,9 +137,9 @@ void FirstApp::loadGameObjects(){
 //    gameObjects.emplace(flat_vase.getId(), std::move(flat_vase));
     scene.addGameObject(std::move(floor));
     
-    auto ball_mdl_id = assetManager.loadModel("sphere.obj");
-    auto smartface_id = assetManager.loadImage("fair-smartface.jpg");
-    auto basket_ball_tex_id = assetManager.loadImage("basket ball.jpg");
+    auto ball_mdl_id = assetManager.loadModelAsync("sphere.obj").id;
+    auto smartface_id = assetManager.loadImageAsync("fair-smartface.jpg").id;
+    auto basket_ball_tex_id = assetManager.loadImageAsync("basket ball.jpg").id;
 
     Material material1{};
     material1.baseColorFactor = {.4f, .84f, .53f, 0.5f};
@@ -14,7 +14,6 @@
 #include "naBuffer.hpp"
 #include "naDescriptors.hpp"
 #include "naPhysicsWorld.hpp"
-#include "naShaderCompiler.hpp"
 #include "Scene.hpp"
 #include "RenderManager.hpp"
 #include "ResourceManager.hpp"
@@ -27,7 +26,6 @@ namespace nary {
 class FirstApp {
 public:
     FirstApp();
-    ~FirstApp();
     
     FirstApp(const FirstApp&) = delete;
     FirstApp operator=(const FirstApp&) = delete;
@@ -36,14 +36,18 @@ public:
         mtl_ids.resize(mtl.size());
         mesh_ids.resize(mesh.size());
 
+        // kick off every decode first, the materials and objects can reference the ids right away
         for (uint32_t i = 0; i < tex.size(); i++) {
-            tex_ids[i] = am.loadImage(tex[i].AsString());
+            tex_ids[i] = am.loadImageAsync(tex[i].AsString()).id;
+        }
+        for (uint32_t i = 0; i < mesh.size(); i++) {
+            mesh_ids[i] = am.loadModelAsync(mesh[i].AsString()).id;
         }
         for (uint32_t i = 0; i < mtl.size(); i++) {
             auto &m = mtl[i];
             auto &base_color = m.AsObject()["base_color"].AsArray();
-            uint32_t base_color_tex = m.AsObject().contains("base_color_tex")
-                                      ? tex_ids[(size_t) m.AsObject()["base_color_tex"].AsNumber()] : 0;
+            nary::AssetRef base_color_tex = m.AsObject().contains("base_color_tex")
+                                            ? tex_ids[(size_t) m.AsObject()["base_color_tex"].AsNumber()] : nary::AssetRef{};
 
             nary::Material mat;
             mat.baseColorFactor = mathpls::vec4(base_color[0].AsNumber(), base_color[1].AsNumber(),
@@ -54,9 +58,6 @@ public:
 
             mtl_ids[i] = rr.addMaterial(mat);
         }
-        for (uint32_t i = 0; i < mesh.size(); i++) {
-            mesh_ids[i] = am.loadModel(mesh[i].AsString());
-        }
 
         std::queue<std::pair<nary::naGameObject::id_t, st::Json>> que;
         que.emplace(-1, json["root"]);
@@ -103,9 +104,10 @@ public:
     }
 
 private:
-    std::vector<uint32_t> tex_ids;
-    std::vector<uint32_t> mtl_ids;
-    std::vector<uint32_t> mesh_ids;
+    // the loader keeps the scene's assets loaded as long as it lives
+    std::vector<nary::AssetRef> tex_ids;
+    std::vector<nary::AssetRef> mtl_ids;
+    std::vector<nary::AssetRef> mesh_ids;
 
     void applyGoComponents(nary::naGameObject *go, st::Json &jobj) {
         {
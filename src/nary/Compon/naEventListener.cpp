@@ -6,6 +6,7 @@
 //
 
 #include "naEventListener.hpp"
+#include "naProfiler.hpp"
 
 namespace nary {
 
@@ -18,6 +19,8 @@ naEventListener::naEventListener() {
 }
 
 void naEventListener::Update(const naWin& window) {
+    NARY_PROFILE_SCOPE("naEventListener::Update");
+
     EVT_STATUS.MainKey = TestSpecialKey(window);
     EVT_STATUS.MinorKey = TestSpecialKey(window, EVT_STATUS.MainKey);
     
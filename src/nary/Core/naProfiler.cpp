@@ -0,0 +1,179 @@
+#include "naProfiler.hpp"
+
+#include "se_tools.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nary {
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+/**
+ * written by its own thread only, the events below count are never touched again during a capture
+ */
+struct ThreadBuffer {
+    std::unique_ptr<Event[]> events{new Event[naProfiler::MAX_EVENTS_PER_THREAD]};
+    std::atomic<size_t> count{0};
+    std::atomic<uint64_t> capture{0};
+    uint32_t tid = 0;
+};
+
+std::mutex s_RegistryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> s_Registry;
+
+std::atomic<bool> s_Capturing{false};
+std::atomic<uint64_t> s_CaptureId{0};
+
+// main thread only
+uint32_t s_FramesLeft = 0;
+uint64_t s_LastFrame = 0;
+std::string s_Filename;
+std::vector<naProfiler::ZoneStats> s_Stats;
+
+const auto s_Epoch = std::chrono::steady_clock::now();
+
+ThreadBuffer& localBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard lock{s_RegistryMutex};
+        buffer->tid = static_cast<uint32_t>(s_Registry.size());
+        s_Registry.push_back(buffer);
+        return buffer;
+    }();
+    return *buffer;
+}
+
+void writeEscaped(std::ofstream& file, const char* str) {
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') file << '\\';
+        file << *str;
+    }
+}
+
+template <class Fn>
+void forEachEvent(uint64_t capture, Fn&& fn) {
+    std::lock_guard lock{s_RegistryMutex};
+    for (auto& buffer : s_Registry) {
+        if (buffer->capture.load(std::memory_order_acquire) != capture)
+            continue;
+        auto count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i)
+            fn(*buffer, buffer->events[i]);
+        if (count >= naProfiler::MAX_EVENTS_PER_THREAD)
+            WARNING_LOG("CPU profiler buffer of thread {} is full, events were dropped", buffer->tid);
+    }
+}
+
+std::vector<naProfiler::ZoneStats> aggregate(uint64_t capture) {
+    auto less = [](const char* a, const char* b) {return std::strcmp(a, b) < 0;};
+    std::map<const char*, naProfiler::ZoneStats, decltype(less)> stats{less};
+    forEachEvent(capture, [&](const ThreadBuffer&, const Event& e) {
+        auto& s = stats[e.name];
+        s.name = e.name;
+        s.count++;
+        s.totalNs += e.end - e.begin;
+        s.maxNs = std::max(s.maxNs, e.end - e.begin);
+    });
+
+    std::vector<naProfiler::ZoneStats> result;
+    for (auto& [name, s] : stats)
+        result.push_back(s);
+    return result;
+}
+
+void dump(uint64_t capture, const std::string& filename) {
+    std::ofstream file{filename};
+    if (!file.is_open()) {
+        WARNING_LOG("Failed to open file: {}", filename);
+        return;
+    }
+
+    size_t total = 0;
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    forEachEvent(capture, [&](const ThreadBuffer& buffer, const Event& e) {
+        file << (total++ ? ",\n" : "\n") << "{\"name\":\"";
+        writeEscaped(file, e.name);
+        file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer.tid
+             << ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0 << "}";
+    });
+    file << "\n]}\n";
+
+    INFO_LOG("CPU trace with {} events written to {}", total, filename);
+}
+
+}
+
+void naProfiler::beginCapture(uint32_t frames, std::string filename) {
+    if (isCapturing()) {
+        WARNING_LOG("CPU profiler is already capturing");
+        return;
+    }
+    if (frames == 0) return;
+
+    s_FramesLeft = frames;
+    s_Filename = std::move(filename);
+    s_LastFrame = now();
+    s_CaptureId.fetch_add(1, std::memory_order_release);
+    s_Capturing.store(true, std::memory_order_release);
+}
+
+bool naProfiler::isCapturing() {
+    return s_Capturing.load(std::memory_order_relaxed);
+}
+
+void naProfiler::frame() {
+    if (!isCapturing()) return;
+
+    auto t = now();
+    record("Frame", s_LastFrame, t);
+    s_LastFrame = t;
+
+    if (--s_FramesLeft == 0) {
+        s_Capturing.store(false, std::memory_order_release);
+        auto capture = s_CaptureId.load(std::memory_order_relaxed);
+        s_Stats = aggregate(capture);
+        if (!s_Filename.empty())
+            dump(capture, s_Filename);
+    }
+}
+
+std::vector<naProfiler::ZoneStats> naProfiler::getCaptureStats() {
+    return s_Stats;
+}
+
+uint64_t naProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_Epoch).count();
+}
+
+void naProfiler::record(const char* name, uint64_t begin, uint64_t end) {
+    auto& buffer = localBuffer();
+
+    // first event of a new capture on this thread, drop the old one
+    auto capture = s_CaptureId.load(std::memory_order_acquire);
+    if (buffer.capture.load(std::memory_order_relaxed) != capture) {
+        buffer.count.store(0, std::memory_order_relaxed);
+        buffer.capture.store(capture, std::memory_order_release);
+    }
+
+    auto count = buffer.count.load(std::memory_order_relaxed);
+    if (count >= MAX_EVENTS_PER_THREAD)
+        return;
+    buffer.events[count] = {name, begin, end};
+    buffer.count.store(count + 1, std::memory_order_release);
+}
+
+}
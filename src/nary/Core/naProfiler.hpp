@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// zones are compiled out of release builds unless NARY_PROFILE is defined to 1 explicitly
+#ifndef NARY_PROFILE
+#ifdef NDEBUG
+#define NARY_PROFILE 0
+#else
+#define NARY_PROFILE 1
+#endif
+#endif
+
+#define NARY_PROFILE_CONCAT_IMPL(a, b) a##b
+#define NARY_PROFILE_CONCAT(a, b) NARY_PROFILE_CONCAT_IMPL(a, b)
+
+#if NARY_PROFILE
+#define NARY_PROFILE_SCOPE(name) ::nary::ProfileZone NARY_PROFILE_CONCAT(profile_zone_, __LINE__){name}
+#define NARY_PROFILE_FUNCTION() NARY_PROFILE_SCOPE(__func__)
+#define NARY_PROFILE_FRAME() ::nary::naProfiler::frame()
+#else
+#define NARY_PROFILE_SCOPE(name) ((void)0)
+#define NARY_PROFILE_FUNCTION() ((void)0)
+#define NARY_PROFILE_FRAME() ((void)0)
+#endif
+
+namespace nary {
+
+/**
+ * CPU frame profiler.
+ * Zones are only recorded while a capture is running, every thread appends to its own buffer
+ * without locking, the buffers are gathered when the capture ends and written as a Chrome trace_event JSON
+ * (open it with chrome://tracing or ui.perfetto.dev).
+ */
+class naProfiler {
+public:
+    static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 16;
+
+    struct ZoneStats {
+        const char* name;
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+    };
+
+    /**
+     * record the next frames and write them to filename once done, an empty filename only keeps the stats
+     */
+    static void beginCapture(uint32_t frames, std::string filename = "cpu_trace.json");
+    static bool isCapturing();
+
+    /**
+     * marks the end of a frame, call once per frame on the main thread
+     */
+    static void frame();
+
+    /**
+     * nanoseconds since the profiler was first used
+     */
+    static uint64_t now();
+
+    /**
+     * per zone totals of the last finished capture, zones of all threads with the same name are merged
+     */
+    static std::vector<ZoneStats> getCaptureStats();
+
+    static void record(const char* name, uint64_t begin, uint64_t end);
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(name), active(naProfiler::isCapturing()) {
+        if (active) begin = naProfiler::now();
+    }
+    ~ProfileZone() {if (active) naProfiler::record(name, begin, naProfiler::now());}
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    bool active;
+    uint64_t begin = 0;
+};
+
+}
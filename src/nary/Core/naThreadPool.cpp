@@ -0,0 +1,85 @@
+#include "naThreadPool.hpp"
+
+#include <algorithm>
+
+namespace nary {
+
+naThreadPool::naThreadPool(uint32_t threadCount) {
+    if (threadCount == 0)
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1; // hardware_concurrency() may return 0
+
+    m_WorkerIds.resize(threadCount);
+    m_Workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_Workers.emplace_back(&naThreadPool::workerLoop, this, i);
+
+    // make sure every worker published its id before anyone asks for workerIndex()
+    std::unique_lock lock{m_Mutex};
+    m_Condition.wait(lock, [&]{
+        return std::none_of(m_WorkerIds.begin(), m_WorkerIds.end(), [](auto&& i){ return i == std::thread::id{}; });
+    });
+}
+
+naThreadPool::~naThreadPool() {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_Stop = true;
+    }
+    m_Condition.notify_all();
+    for (auto& i : m_Workers)
+        i.join();
+}
+
+uint32_t naThreadPool::workerIndex() const {
+    auto id = std::this_thread::get_id();
+    auto it = std::find(m_WorkerIds.begin(), m_WorkerIds.end(), id);
+    return static_cast<uint32_t>(it - m_WorkerIds.begin());
+}
+
+void naThreadPool::enqueue(std::function<void()>&& job) {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_Jobs.push(std::move(job));
+    }
+    m_Condition.notify_one();
+}
+
+void naThreadPool::workerLoop(uint32_t index) {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_WorkerIds[index] = std::this_thread::get_id();
+    }
+    m_Condition.notify_all();
+
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock{m_Mutex};
+            m_Condition.wait(lock, [&]{ return m_Stop || !m_Jobs.empty(); });
+            if (m_Stop && m_Jobs.empty())
+                return;
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop();
+        }
+        job();
+    }
+}
+
+void naThreadPool::parallelFor(size_t count, size_t chunkCount, const std::function<void(size_t, size_t, size_t)>& fn) {
+    if (count == 0 || chunkCount == 0) return;
+    chunkCount = std::min(chunkCount, count);
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(chunkCount);
+
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    for (size_t chunk = 0, begin = 0; begin < count; ++chunk, begin += chunkSize) {
+        size_t end = std::min(begin + chunkSize, count);
+        futures.push_back(submit([&fn, begin, end, chunk]{ fn(begin, end, chunk); }));
+    }
+
+    for (auto& i : futures)
+        i.get(); // rethrows exceptions of the workers
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace nary {
+
+/**
+ * A fixed size pool of worker threads.
+ * Each worker owns a stable index in [0, size()), so per-thread resources
+ * (command pools, scratch buffers...) can be indexed by workerIndex().
+ */
+class naThreadPool {
+public:
+    /**
+     * \param threadCount 0 means hardware_concurrency() - 1 (at least 1)
+     */
+    explicit naThreadPool(uint32_t threadCount = 0);
+    ~naThreadPool();
+
+    naThreadPool(const naThreadPool&) = delete;
+    naThreadPool& operator=(const naThreadPool&) = delete;
+
+    uint32_t size() const {return static_cast<uint32_t>(m_Workers.size());}
+
+    /**
+     * index of the calling worker thread, or size() when called from a thread not owned by this pool
+     */
+    uint32_t workerIndex() const;
+
+    template <class Fn, class R = std::invoke_result_t<Fn>>
+    std::future<R> submit(Fn&& fn) {
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<Fn>(fn));
+        auto future = task->get_future();
+        enqueue([task]{ (*task)(); });
+        return future;
+    }
+
+    /**
+     * Split [0, count) into at most `chunkCount` contiguous ranges and run fn(begin, end, chunkIndex) on the workers.
+     * Blocks until every chunk is done.
+     * @note don't call it from a worker of the same pool, it would wait on itself
+     */
+    void parallelFor(size_t count, size_t chunkCount, const std::function<void(size_t, size_t, size_t)>& fn);
+
+private:
+    void enqueue(std::function<void()>&& job);
+    void workerLoop(uint32_t index);
+
+    std::vector<std::thread> m_Workers;
+    std::vector<std::thread::id> m_WorkerIds;
+    std::queue<std::function<void()>> m_Jobs;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stop = false;
+};
+
+}
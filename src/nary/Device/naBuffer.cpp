@@ -10,6 +10,7 @@
 // std
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
 
 namespace nary {
 
@@ -43,27 +44,44 @@ naBuffer::naBuffer(
       memoryPropertyFlags{memoryPropertyFlags} {
   alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
   bufferSize = alignmentSize * instanceCount;
-  device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = bufferSize;
+  bufferInfo.usage = usageFlags;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // suballocated from the device's VMA blocks, large buffers get their own memory
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.requiredFlags = memoryPropertyFlags;
+
+  if (vmaCreateBuffer(device.assetAllocator(), &bufferInfo, &allocInfo, &buffer, &allocation, nullptr) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create buffer!");
+  }
+  vmaGetAllocationMemoryProperties(device.assetAllocator(), allocation, &this->memoryPropertyFlags);
 }
 
 naBuffer::~naBuffer() {
   unmap();
-  vkDestroyBuffer(device.device(), buffer, nullptr);
-  vkFreeMemory(device.device(), memory, nullptr);
+  vmaDestroyBuffer(device.assetAllocator(), buffer, allocation);
 }
 
 /**
- * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+ * Map the memory of this buffer. If successful, mapped points offset bytes into the buffer.
+ * Mapping a buffer that is already mapped does nothing.
  *
- * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
- * buffer range.
+ * @param size Unused, VMA always maps the whole allocation
  * @param offset (Optional) Byte offset from beginning
  *
  * @return VkResult of the buffer mapping call
  */
 VkResult naBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(buffer && memory && "Called map on buffer before create");
-  return vkMapMemory(device.device(), memory, offset, size, 0, &mapped);
+  assert(buffer && allocation && "Called map on buffer before create");
+  // VMA counts the mappings, mapping again would leak one that unmap never releases
+  if (mapped) return VK_SUCCESS;
+  auto result = vmaMapMemory(device.assetAllocator(), allocation, &mapped);
+  if (result == VK_SUCCESS) mapped = static_cast<char *>(mapped) + offset;
+  return result;
 }
 
 /**
@@ -73,7 +91,7 @@ VkResult naBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
  */
 void naBuffer::unmap() {
   if (mapped) {
-    vkUnmapMemory(device.device(), memory);
+    vmaUnmapMemory(device.assetAllocator(), allocation);
     mapped = nullptr;
   }
 }
@@ -111,12 +129,7 @@ void naBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset)
  * @return VkResult of the flush call
  */
 VkResult naBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkFlushMappedMemoryRanges(device.device(), 1, &mappedRange);
+  return vmaFlushAllocation(device.assetAllocator(), allocation, offset, size);
 }
 
 /**
@@ -131,12 +144,7 @@ VkResult naBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult naBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkInvalidateMappedMemoryRanges(device.device(), 1, &mappedRange);
+  return vmaInvalidateAllocation(device.assetAllocator(), allocation, offset, size);
 }
 
 /**
@@ -38,6 +38,9 @@ public:
     VkDeviceSize getInstanceSize() const { return instanceSize; }
     VkDeviceSize getAlignmentSize() const { return instanceSize; }
     VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
+    /**
+     * of the memory type the buffer got, at least the requested flags
+     */
     VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
     VkDeviceSize getBufferSize() const { return bufferSize; }
     
@@ -47,7 +50,7 @@ private:
     naDevice& device;
     void* mapped = nullptr;
     VkBuffer buffer = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
     
     VkDeviceSize bufferSize;
     uint32_t instanceCount;
@@ -7,8 +7,10 @@
 
 #include "naDescriptors.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
+#include <utility>
 
 namespace nary {
 
@@ -18,7 +20,8 @@ naDescriptorSetLayout::Builder& naDescriptorSetLayout::Builder::addBinding(
     uint32_t binding,
     VkDescriptorType descriptorType,
     VkShaderStageFlags stageFlags,
-    uint32_t count) {
+    uint32_t count,
+    VkDescriptorBindingFlagsEXT flags) {
     assert(bindings.count(binding) == 0 && "Binding already in use");
     VkDescriptorSetLayoutBinding layoutBinding{};
     layoutBinding.binding = binding;
@@ -26,27 +29,43 @@ naDescriptorSetLayout::Builder& naDescriptorSetLayout::Builder::addBinding(
     layoutBinding.descriptorCount = count;
     layoutBinding.stageFlags = stageFlags;
     bindings[binding] = layoutBinding;
+    if (flags) bindingFlags[binding] = flags;
     return *this;
 }
 
 std::unique_ptr<naDescriptorSetLayout> naDescriptorSetLayout::Builder::build() const {
-    return std::make_unique<naDescriptorSetLayout>(device, bindings);
+    return std::make_unique<naDescriptorSetLayout>(device, bindings, bindingFlags);
 }
 
 // *************** Descriptor Set Layout *********************
 
 naDescriptorSetLayout::naDescriptorSetLayout(
-    naDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+    naDevice& device,
+    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+    const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT>& bindingFlags)
 : device{device}, bindings{bindings} {
     std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+    std::vector<VkDescriptorBindingFlagsEXT> flags{}; // parallel to setLayoutBindings
     for (auto kv : bindings) {
         setLayoutBindings.push_back(kv.second);
+        auto it = bindingFlags.find(kv.first);
+        flags.push_back(it != bindingFlags.end() ? it->second : 0);
+        if (flags.back() & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT) updateAfterBind = true;
     }
     
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(flags.size());
+    bindingFlagsInfo.pBindingFlags = flags.data();
+    
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
     descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
     descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
+    if (!bindingFlags.empty())
+        descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+    if (updateAfterBind)
+        descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
     
     if (vkCreateDescriptorSetLayout(device.device(),
                                     &descriptorSetLayoutInfo,
@@ -54,12 +73,69 @@ naDescriptorSetLayout::naDescriptorSetLayout(
                                     &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
+    createUpdateTemplate();
 }
 
 naDescriptorSetLayout::~naDescriptorSetLayout() {
+    vkDestroyDescriptorUpdateTemplate(device.device(), updateTemplate, nullptr);
     vkDestroyDescriptorSetLayout(device.device(), descriptorSetLayout, nullptr);
 }
 
+void naDescriptorSetLayout::createUpdateTemplate() {
+    if (bindings.empty()) return;
+    
+    std::vector<VkDescriptorSetLayoutBinding> sorted;
+    for (auto& [binding, info] : bindings) sorted.push_back(info);
+    std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) { return a.binding < b.binding; });
+    
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    size_t offset = 0;
+    for (auto& b : sorted) {
+        VkDescriptorUpdateTemplateEntry entry{};
+        entry.dstBinding = b.binding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = b.descriptorCount;
+        entry.descriptorType = b.descriptorType;
+        entry.offset = offset;
+        entry.stride = sizeof(naDescriptorInfo);
+        entries.push_back(entry);
+        offset += b.descriptorCount * sizeof(naDescriptorInfo);
+    }
+    
+    VkDescriptorUpdateTemplateCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    createInfo.pDescriptorUpdateEntries = entries.data();
+    createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    createInfo.descriptorSetLayout = descriptorSetLayout;
+    
+    if (vkCreateDescriptorUpdateTemplate(device.device(), &createInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor update template!");
+    }
+}
+
+void naDescriptorSetLayout::update(VkDescriptorSet set, const void* data) const {
+    assert(updateTemplate && "the layout has no bindings");
+    vkUpdateDescriptorSetWithTemplate(device.device(), set, updateTemplate, data);
+}
+
+void naDescriptorSetLayout::updateElement(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, const naDescriptorInfo& info) const {
+    auto& bindingDescription = bindings.at(binding);
+    assert(arrayElement < bindingDescription.descriptorCount && "Array element out of range");
+    
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = binding;
+    write.dstArrayElement = arrayElement;
+    write.descriptorCount = 1;
+    write.descriptorType = bindingDescription.descriptorType;
+    write.pBufferInfo = &info.buffer;
+    write.pImageInfo = &info.image;
+    write.pTexelBufferView = &info.texelBuffer;
+    vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+}
+
 // *************** Descriptor Pool Builder *********************
 
 naDescriptorPool::Builder& naDescriptorPool::Builder::addPoolSize(
@@ -113,8 +189,7 @@ bool naDescriptorPool::allocateDescriptor(const VkDescriptorSetLayout descriptor
     allocInfo.pSetLayouts = &descriptorSetLayout;
     allocInfo.descriptorSetCount = 1;
     
-    // Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-    // a new pool whenever an old pool fills up. But this is beyond our current scope
+    // a full pool fails here, naDescriptorAllocator moves on to another one
     if (vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptor) != VK_SUCCESS) {
         return false;
     }
@@ -132,9 +207,56 @@ void naDescriptorPool::resetPool() {
     vkResetDescriptorPool(device.device(), descriptorPool, 0);
 }
 
+// *************** Descriptor Allocator *********************
+
+naDescriptorAllocator::naDescriptorAllocator(naDevice& device, uint32_t setsPerPool, std::vector<PoolSizeRatio> ratios)
+: device{device}, ratios{std::move(ratios)}, setsPerPool{setsPerPool} {}
+
+naDescriptorPool& naDescriptorAllocator::addPool() {
+    naDescriptorPool::Builder builder{device};
+    builder.setMaxSets(setsPerPool);
+    for (auto& [type, ratio] : ratios)
+        builder.addPoolSize(type, std::max(1u, static_cast<uint32_t>(ratio * setsPerPool)));
+    pools.push_back(builder.build());
+    
+    // every pool is bigger than the last, so a growing scene adds few of them
+    setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+    return *pools.back();
+}
+
+bool naDescriptorAllocator::allocate(VkDescriptorSetLayout setLayout, VkDescriptorSet& set) {
+    if (auto it = freeSets.find(setLayout); it != freeSets.end() && !it->second.empty()) {
+        set = it->second.back();
+        it->second.pop_back();
+        return true;
+    }
+    
+    for (;; ++current) {
+        bool fresh = current == pools.size();
+        auto& pool = fresh ? addPool() : *pools[current];
+        if (pool.allocateDescriptor(setLayout, set))
+            return true;
+        if (fresh)
+            return false; // doesn't fit an empty pool either
+    }
+}
+
+void naDescriptorAllocator::free(VkDescriptorSetLayout setLayout, VkDescriptorSet set) {
+    freeSets[setLayout].push_back(set);
+}
+
+void naDescriptorAllocator::reset() {
+    for (auto& pool : pools) pool->resetPool();
+    current = 0;
+    freeSets.clear();
+}
+
 // *************** Descriptor Writer *********************
 
-naDescriptorWriter::naDescriptorWriter(naDescriptorSetLayout& setLayout, naDescriptorPool& pool) : setLayout{setLayout}, pool{pool} {}
+naDescriptorWriter::naDescriptorWriter(naDescriptorSetLayout& setLayout, naDescriptorPool& pool) : setLayout{setLayout}, pool{&pool} {}
+
+naDescriptorWriter::naDescriptorWriter(naDescriptorSetLayout& setLayout, naDescriptorAllocator& allocator)
+: setLayout{setLayout}, allocator{&allocator} {}
 
 naDescriptorWriter &naDescriptorWriter::writeBuffer(
     uint32_t binding, VkDescriptorBufferInfo *bufferInfo) {
@@ -179,7 +301,7 @@ naDescriptorWriter& naDescriptorWriter::writeImage(
 }
 
 bool naDescriptorWriter::build(VkDescriptorSet& set) {
-    bool success = pool.allocateDescriptor(setLayout.get(), set);
+    bool success = allocator ? allocator->allocate(setLayout.get(), set) : pool->allocateDescriptor(setLayout.get(), set);
     if (!success) {
         return false;
     }
@@ -191,7 +313,7 @@ void naDescriptorWriter::overwrite(VkDescriptorSet& set) {
     for (auto &write : writes) {
         write.dstSet = set;
     }
-    vkUpdateDescriptorSets(pool.device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    vkUpdateDescriptorSets(setLayout.device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 }
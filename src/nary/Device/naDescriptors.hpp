@@ -15,34 +15,67 @@
 
 namespace nary {
 
+/**
+ * one descriptor in the data given to an update template
+ */
+union naDescriptorInfo {
+    VkDescriptorBufferInfo buffer;
+    VkDescriptorImageInfo image;
+    VkBufferView texelBuffer;
+};
+
 class naDescriptorSetLayout {
 public:
     class Builder {
     public:
         Builder(naDevice &device) : device{device} {}
         
+        /**
+         * @param flags VkDescriptorBindingFlagBitsEXT, needs descriptor indexing.
+         *              An update after bind binding makes the layout one for update after bind pools
+         */
         Builder& addBinding(uint32_t binding,
                             VkDescriptorType descriptorType,
                             VkShaderStageFlags stageFlags,
-                            uint32_t count = 1);
+                            uint32_t count = 1,
+                            VkDescriptorBindingFlagsEXT flags = 0);
         std::unique_ptr<naDescriptorSetLayout> build() const;
         
     private:
         naDevice& device;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+        std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> bindingFlags{};
     };
     
-    naDescriptorSetLayout(naDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+    naDescriptorSetLayout(naDevice& device,
+                          std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+                          const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT>& bindingFlags = {});
     ~naDescriptorSetLayout();
     naDescriptorSetLayout(const naDescriptorSetLayout&) = delete;
     naDescriptorSetLayout& operator=(const naDescriptorSetLayout &) = delete;
     
     VkDescriptorSetLayout get() const { return descriptorSetLayout; }
     
+    /**
+     * writes every descriptor of the set in one call through the layout's update template,
+     * data holds one naDescriptorInfo per descriptor, ordered by binding and array element
+     */
+    void update(VkDescriptorSet set, const void* data) const;
+    /**
+     * writes a single array element, e.g. one texture of a bindless array
+     */
+    void updateElement(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, const naDescriptorInfo& info) const;
+    
+    bool isUpdateAfterBind() const { return updateAfterBind; }
+    
 private:
+    void createUpdateTemplate();
+    
     naDevice& device;
     VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+    bool updateAfterBind = false; // sets need a pool created with VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT
     
     friend class naDescriptorWriter;
 };
@@ -92,9 +125,58 @@ private:
     friend class naDescriptorWriter;
 };
 
+/**
+ * Hands out descriptor sets from a chain of pools, a bigger pool is added whenever the current ones are full.
+ * Freed sets are kept by layout and handed out again instead of going back to the pool.
+ */
+class naDescriptorAllocator {
+public:
+    struct PoolSizeRatio {
+        VkDescriptorType type;
+        float ratio; // descriptors of the type per set
+    };
+    
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+    
+    naDescriptorAllocator(naDevice& device, uint32_t setsPerPool = 64, std::vector<PoolSizeRatio> ratios = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .25f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .25f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, .25f},
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, .25f}
+    });
+    naDescriptorAllocator(const naDescriptorAllocator&) = delete;
+    naDescriptorAllocator& operator=(const naDescriptorAllocator&) = delete;
+    
+    bool allocate(VkDescriptorSetLayout setLayout, VkDescriptorSet& set);
+    /**
+     * the set is handed out again for the same layout, so only free sets the GPU is done with
+     */
+    void free(VkDescriptorSetLayout setLayout, VkDescriptorSet set);
+    /**
+     * resets every pool, all sets handed out so far become invalid
+     */
+    void reset();
+    
+    size_t getPoolCount() const { return pools.size(); }
+    
+private:
+    naDescriptorPool& addPool();
+    
+    naDevice& device;
+    std::vector<PoolSizeRatio> ratios;
+    uint32_t setsPerPool;
+    
+    std::vector<std::unique_ptr<naDescriptorPool>> pools;
+    size_t current = 0; // the pools before it are full
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+};
+
 class naDescriptorWriter {
 public:
     naDescriptorWriter(naDescriptorSetLayout& setLayout, naDescriptorPool& pool);
+    naDescriptorWriter(naDescriptorSetLayout& setLayout, naDescriptorAllocator& allocator);
     
     naDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
     naDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
@@ -104,7 +186,8 @@ public:
     
 private:
     naDescriptorSetLayout& setLayout;
-    naDescriptorPool& pool;
+    naDescriptorPool* pool = nullptr;
+    naDescriptorAllocator* allocator = nullptr;
     std::vector<VkWriteDescriptorSet> writes;
 };
 
@@ -1,14 +1,24 @@
 #include "naDevice.hpp"
+#include "naUploadManager.hpp"
+#include "naLayoutCache.hpp"
+#include "naSwapChain.hpp"
 #include "VulkanUtil.hpp"
+#include "resource_path.h"
 
 // std headers
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
 
 #define NARY_VK_VERSION VK_API_VERSION_1_1
 
+// upper bound of a bindless array, the device limit may be lower
+constexpr uint32_t MAX_BINDLESS_DESCRIPTORS = 4096;
+
 namespace nary {
 
 // local callback functions
@@ -50,18 +60,39 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-naDevice::naDevice(naWin &window) : window{window} {
+naDevice::naDevice(naWin &window) : window{&window} {
+  init();
+}
+
+naDevice::naDevice() {
+  std::erase_if(deviceExtensions, [](const char *ext) {
+    return strcmp(ext, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+  });
+  init();
+}
+
+void naDevice::init() {
   createInstance();
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  createPipelineCache();
   createAssetAllocator();
+  createUploadManager();
+  layoutCache_ = std::make_unique<naLayoutCache>(*this);
 }
 
 naDevice::~naDevice() {
+  flushDeletionQueue();
+  uploadManager_.reset();
+  layoutCache_.reset();
   VulkanUtil::clear(device_);
+  vmaDestroyAllocator(assetAllocator_);
+
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
 
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
@@ -70,7 +101,9 @@ naDevice::~naDevice() {
     DestroyDebugUtilsMessengerEXT(instance_, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance_, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance_, surface_, nullptr);
+  }
   vkDestroyInstance(instance_, nullptr);
 }
 
@@ -143,13 +176,81 @@ void naDevice::pickPhysicalDevice() {
 
   vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
   std::cout << "physical device: " << properties.deviceName << std::endl;
+
+  queryDescriptorIndexing();
+  memoryBudget_ = isDeviceExtensionAvailable(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  queryDirectUploads();
+}
+
+void naDevice::queryDirectUploads() {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memProperties);
+
+  // a discrete GPU without resizable BAR only maps a 256 MiB window of its largest device local heap
+  VkDeviceSize largestHeap = 0, mappableHeap = 0;
+  for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+    if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+      largestHeap = std::max(largestHeap, memProperties.memoryHeaps[i].size);
+  }
+  constexpr VkMemoryPropertyFlags mappable = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    auto &type = memProperties.memoryTypes[i];
+    if ((type.propertyFlags & mappable) == mappable)
+      mappableHeap = std::max(mappableHeap, memProperties.memoryHeaps[type.heapIndex].size);
+  }
+
+  bool unified = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+                 properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+  directUploads_ = mappableHeap > 0 && (unified || mappableHeap == largestHeap);
+  std::cout << "mesh uploads: " << (directUploads_ ? "direct" : "staged") << std::endl;
+}
+
+bool naDevice::isDeviceExtensionAvailable(const char *extension) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice_, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice_, nullptr, &extensionCount, availableExtensions.data());
+  return std::any_of(availableExtensions.begin(), availableExtensions.end(), [=](auto &e) {
+    return strcmp(e.extensionName, extension) == 0;
+  });
+}
+
+void naDevice::queryDescriptorIndexing() {
+  if (!isDeviceExtensionAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+    std::cout << "descriptor indexing unsupported, textures are bound per material" << std::endl;
+    return;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &indexingFeatures;
+  vkGetPhysicalDeviceFeatures2(physicalDevice_, &features);
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+  indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2 properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties2.pNext = &indexingProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice_, &properties2);
+
+  // textures are written while earlier frames still sample the other slots of the array
+  if (indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound &&
+      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+      indexingFeatures.descriptorBindingUpdateUnusedWhilePending) {
+    bindlessDescriptors_ = std::min({MAX_BINDLESS_DESCRIPTORS,
+                                     indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                     indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+  }
+  std::cout << "bindless descriptors: " << bindlessDescriptors_ << std::endl;
 }
 
 void naDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice_);
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -164,6 +265,19 @@ void naDevice::createLogicalDevice() {
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  if (memoryBudget_)
+    deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  if (supportsBindless()) {
+    deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  }
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -171,6 +285,7 @@ void naDevice::createLogicalDevice() {
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
+  createInfo.pNext = supportsBindless() ? &indexingFeatures : nullptr;
   createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
   createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -189,6 +304,7 @@ void naDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
 }
 
 void naDevice::createCommandPool() {
@@ -205,7 +321,91 @@ void naDevice::createCommandPool() {
   }
 }
 
-void naDevice::createSurface() { window.createWindowSurface(instance_, &surface_); }
+void naDevice::createSurface() {
+  if (isHeadless()) return;
+  window->createWindowSurface(instance_, &surface_);
+}
+
+static std::filesystem::path pipelineCacheFilename() {
+  return res::fullname(res::shaderCachePath, "pipeline_cache.bin");
+}
+
+void naDevice::createPipelineCache() {
+  auto begin = std::chrono::steady_clock::now();
+
+  std::vector<char> data;
+  std::ifstream ifs(pipelineCacheFilename(), std::ios::ate | std::ios::binary);
+  if (ifs.good()) {
+    data.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    ifs.read(data.data(), data.size());
+    if (!isPipelineCacheCompatible(data)) {
+      WARNING_LOG("pipeline cache was written by another device or driver, it is discarded");
+      data.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = data.size();
+  createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(device_, &createInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+
+  auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+  INFO_LOG("pipeline cache: {} bytes loaded in {} ms", data.size(), ms);
+}
+
+bool naDevice::isPipelineCacheCompatible(const std::vector<char> &data) {
+  // VkPipelineCacheHeaderVersionOne, the layout is fixed by the spec
+  struct {
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  } header;
+  static_assert(sizeof(header) == 16 + VK_UUID_SIZE);
+
+  if (data.size() < sizeof(header)) return false;
+  memcpy(&header, data.data(), sizeof(header));
+
+  return header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void naDevice::savePipelineCache() {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) return;
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+    WARNING_LOG("failed to read back the pipeline cache");
+    return;
+  }
+
+  // write to a temporary file first, a crash while writing must not leave a truncated cache behind
+  auto filename = pipelineCacheFilename();
+  auto tmp = filename;
+  tmp += ".tmp";
+  std::error_code ec;
+  std::filesystem::create_directories(filename.parent_path(), ec); // the first run has no cache directory yet
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs.good()) {
+      WARNING_LOG("Failed to open file: {}", tmp.string());
+      return;
+    }
+    ofs.write(data.data(), size);
+  }
+  std::filesystem::rename(tmp, filename, ec);
+  if (ec) WARNING_LOG("failed to save pipeline cache: {}", ec.message());
+}
 
 void naDevice::createAssetAllocator() {
   VmaAllocatorCreateInfo allocatorCreateInfo = {};
@@ -213,8 +413,40 @@ void naDevice::createAssetAllocator() {
   allocatorCreateInfo.physicalDevice         = physicalDevice_;
   allocatorCreateInfo.device                 = device_;
   allocatorCreateInfo.instance               = instance_;
+  if (memoryBudget_)
+    allocatorCreateInfo.flags               |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+
+  // every naBuffer and naImage is suballocated from it
+  if (vmaCreateAllocator(&allocatorCreateInfo, &assetAllocator_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create memory allocator!");
+  }
+}
+
+std::vector<MemoryHeapStats> naDevice::getMemoryStats() {
+  const VkPhysicalDeviceMemoryProperties *memoryProperties;
+  vmaGetMemoryProperties(assetAllocator_, &memoryProperties);
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+  vmaGetHeapBudgets(assetAllocator_, budgets);
+
+  std::vector<MemoryHeapStats> stats(memoryProperties->memoryHeapCount);
+  for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+    auto &heap = memoryProperties->memoryHeaps[i];
+    auto &budget = budgets[i];
+    stats[i] = {
+        heap.size,
+        budget.budget,
+        budget.usage,
+        budget.statistics.blockBytes,
+        budget.statistics.allocationBytes,
+        budget.statistics.blockCount,
+        budget.statistics.allocationCount,
+        (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0};
+  }
+  return stats;
+}
 
-  vmaCreateAllocator(&allocatorCreateInfo, &assetAllocator_);
+void naDevice::createUploadManager() {
+  uploadManager_ = std::make_unique<naUploadManager>(*this);
 }
 
 bool naDevice::isDeviceSuitable(VkPhysicalDevice device) {
@@ -222,8 +454,8 @@ bool naDevice::isDeviceSuitable(VkPhysicalDevice device) {
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  bool swapChainAdequate = isHeadless();
+  if (extensionsSupported && !isHeadless()) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -282,11 +514,15 @@ bool naDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> naDevice::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+
+  // glfw may not even be initialized without a window
+  if (!isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -347,24 +583,39 @@ QueueFamilyIndices naDevice::findQueueFamilies(VkPhysicalDevice device) {
   std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+  bool hasDedicatedTransfer = false;
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-      indices.graphicsFamily = i;
-      indices.graphicsFamilyHasValue = true;
-    }
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
-      indices.presentFamily = i;
-      indices.presentFamilyHasValue = true;
+    if (!indices.isComplete()) {
+      if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        indices.graphicsFamily = i;
+        indices.graphicsFamilyHasValue = true;
+      }
+      VkBool32 presentSupport = false;
+      if (isHeadless()) {
+        // nothing is presented, the graphics queue stands in
+        presentSupport = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+      } else {
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+      }
+      if (queueFamily.queueCount > 0 && presentSupport) {
+        indices.presentFamily = i;
+        indices.presentFamilyHasValue = true;
+      }
     }
-    if (indices.isComplete()) {
-      break;
+    // prefer a pure transfer family (usually backed by a DMA engine)
+    if (!hasDedicatedTransfer && queueFamily.queueCount > 0 &&
+        (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+        !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      indices.transferFamily = i;
+      hasDedicatedTransfer = true;
     }
 
     i++;
   }
+  if (!hasDedicatedTransfer) {
+    indices.transferFamily = indices.graphicsFamily;
+  }
 
   return indices;
 }
@@ -439,37 +690,6 @@ VkSampleCountFlagBits naDevice::getMaxUsableSampleCount() {
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
-void naDevice::createBuffer(
-    VkDeviceSize size,
-    VkBufferUsageFlags usage,
-    VkMemoryPropertyFlags properties,
-    VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
-  VkBufferCreateInfo bufferInfo{};
-  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = size;
-  bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create vertex buffer!");
-  }
-
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
-  }
-
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
-}
-
 VkCommandBuffer naDevice::beginSingleTimeCommands() {
   VkCommandBufferAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -502,68 +722,42 @@ void naDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void naDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0;  // Optional
-  copyRegion.dstOffset = 0;  // Optional
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  endSingleTimeCommands(commandBuffer);
+void naDevice::deferDestroy(std::function<void()> deleter) {
+  std::lock_guard lock{deletionMutex_};
+  deletionQueue_.push_back({frame_.load(std::memory_order_relaxed), std::move(deleter)});
 }
 
-void naDevice::copyBufferToImage(
-    VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferImageCopy region{};
-  region.bufferOffset = 0;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
-
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = layerCount;
-
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {width, height, 1};
-
-  vkCmdCopyBufferToImage(
-      commandBuffer,
-      buffer,
-      image,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      1,
-      &region);
-  endSingleTimeCommands(commandBuffer);
-}
-
-void naDevice::createImageWithInfo(
-    const VkImageCreateInfo &imageInfo,
-    VkMemoryPropertyFlags properties,
-    VkImage &image,
-    VkDeviceMemory &imageMemory) {
-  if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create image!");
+void naDevice::beginFrame() {
+  // frame N only begins once frame N - MAX_FRAMES_IN_FLIGHT has finished,
+  // so whatever was released during frame R is unused from frame R + MAX_FRAMES_IN_FLIGHT on
+  uint64_t frame;
+  std::vector<std::function<void()>> expired;
+  {
+    // deferDestroy() tags entries with the frame under the same lock
+    std::lock_guard lock{deletionMutex_};
+    frame = frame_.load(std::memory_order_relaxed) + 1;
+    frame_.store(frame, std::memory_order_release);
+    while (!deletionQueue_.empty() && deletionQueue_.front().frame + naSwapChain::MAX_FRAMES_IN_FLIGHT <= frame) {
+      expired.push_back(std::move(deletionQueue_.front().deleter));
+      deletionQueue_.pop_front();
+    }
   }
+  // outside the lock, a deleter may release further resources
+  for (auto &deleter : expired) deleter();
 
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(device_, image, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
+  // VMA refreshes the heap budgets per frame
+  vmaSetCurrentFrameIndex(assetAllocator_, static_cast<uint32_t>(frame));
+}
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
+void naDevice::flushDeletionQueue() {
+  for (;;) {
+    std::deque<Deletion> queue;
+    {
+      std::lock_guard lock{deletionMutex_};
+      if (deletionQueue_.empty()) return;
+      queue.swap(deletionQueue_);
+    }
+    for (auto &i : queue) i.deleter();
   }
 }
 
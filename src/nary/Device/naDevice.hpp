@@ -5,11 +5,19 @@
 #include "vk_mem_alloc.h"
 
 // std lib headers
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace nary {
 
+class naUploadManager;
+class naLayoutCache;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -19,11 +27,26 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  uint32_t transferFamily;  // a transfer-only family if there is one, graphicsFamily otherwise
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+struct MemoryHeapStats {
+  VkDeviceSize size;             // of the heap
+  VkDeviceSize budget;           // what the process may use, from VK_EXT_memory_budget if supported, estimated otherwise
+  VkDeviceSize usage;            // of the process, including memory not allocated through VMA
+  VkDeviceSize blockBytes;       // VkDeviceMemory allocated by VMA
+  VkDeviceSize allocationBytes;  // used by resources inside those blocks
+  uint32_t blockCount;
+  uint32_t allocationCount;
+  bool deviceLocal;
+
+  // share of the VMA blocks no resource uses
+  float fragmentation() const { return blockBytes ? 1.f - static_cast<float>(allocationBytes) / blockBytes : 0.f; }
+};
+
 class naDevice {
  public:
 #ifdef NDEBUG
@@ -33,6 +56,11 @@ class naDevice {
 #endif
 
   naDevice(naWin &window);
+  /**
+   * headless device, no surface, no present queue and no swapchain extension,
+   * render into offscreen targets only (e.g. CI with a software ICD)
+   */
+  naDevice();
   ~naDevice();
 
   // Not copyable or movable
@@ -44,11 +72,39 @@ class naDevice {
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
+  bool isHeadless() const { return window == nullptr; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
   VkPhysicalDevice physicalDevice() { return physicalDevice_; }
   VkInstance instance() { return instance_; }
   VmaAllocator assetAllocator() { return assetAllocator_; }
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
+  naUploadManager &uploader() { return *uploadManager_; }
+  naLayoutCache &layoutCache() { return *layoutCache_; }
+
+  /**
+   * VK_EXT_descriptor_indexing with partially bound, update after bind sampled image arrays,
+   * runtime sized arrays in shaders get maxBindlessDescriptors() elements
+   */
+  bool supportsBindless() const { return bindlessDescriptors_ > 0; }
+  uint32_t maxBindlessDescriptors() const { return bindlessDescriptors_; }
+
+  /**
+   * budget and VMA statistics of every memory heap, cheap enough to call every frame
+   */
+  std::vector<MemoryHeapStats> getMemoryStats();
+  bool hasMemoryBudget() const { return memoryBudget_; }
+
+  /**
+   * all device local memory is also host visible (UMA, resizable BAR),
+   * static buffers are written in place instead of going through a staging copy
+   */
+  bool directUploads() const { return directUploads_; }
+  /**
+   * e.g. to compare both upload paths
+   */
+  void disableDirectUploads() { directUploads_ = false; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice_); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -57,36 +113,51 @@ class naDevice {
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
   VkSampleCountFlagBits getMaxUsableSampleCount();
 
-  // Buffer Helper Functions
-  void createBuffer(
-      VkDeviceSize size,
-      VkBufferUsageFlags usage,
-      VkMemoryPropertyFlags properties,
-      VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+  // buffers and images allocate through assetAllocator(), see naBuffer and naImage::createImage
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-  void copyBufferToImage(
-      VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
-
-  void createImageWithInfo(
-      const VkImageCreateInfo &imageInfo,
-      VkMemoryPropertyFlags properties,
-      VkImage &image,
-      VkDeviceMemory &imageMemory);
+
   VkImageView createImageView(VkImage image, VkFormat format, uint32_t mipLevels = 1);
 
+  /**
+   * runs the deleter once every frame that may use the resource has finished, no device wait needed,
+   * e.g. to unload a streamed asset or replace a pipeline while frames are in flight
+   */
+  void deferDestroy(std::function<void()> deleter);
+  /**
+   * call once per frame after the frame's fence was waited on, destroys what the finished frames left behind
+   */
+  void beginFrame();
+  /**
+   * the caller made sure the GPU is done, e.g. on shutdown
+   */
+  void flushDeletionQueue();
+  /**
+   * number of frames begun so far
+   */
+  uint64_t currentFrame() const { return frame_.load(std::memory_order_acquire); }
+
+  /**
+   * write the pipeline cache to res::shaderCachePath, also done when the device is destroyed
+   */
+  void savePipelineCache();
+
   VkPhysicalDeviceProperties properties;
 
  private:
+  void init();
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
   void createAssetAllocator();
+  void createUploadManager();
+  void queryDescriptorIndexing();
+  bool isDeviceExtensionAvailable(const char *extension);
+  void queryDirectUploads();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -96,24 +167,49 @@ class naDevice {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isPipelineCacheCompatible(const std::vector<char> &data);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance_;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
-  naWin &window;
+  naWin *window = nullptr;
   VkCommandPool commandPool;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
 
   // asset allocator use VMA library
   VmaAllocator assetAllocator_;
 
+  // shared by every pipeline, persisted between runs so the driver skips recompiling them
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+
+  // batches buffer/image uploads instead of stalling the queue for each copy
+  std::unique_ptr<naUploadManager> uploadManager_;
+
+  // descriptor set and pipeline layouts generated from shader reflection
+  std::unique_ptr<naLayoutCache> layoutCache_;
+
+  // 0 if descriptor indexing is unsupported
+  uint32_t bindlessDescriptors_ = 0;
+  // VK_EXT_memory_budget is enabled, VMA reads the budget from the driver
+  bool memoryBudget_ = false;
+  bool directUploads_ = false;
+
+  struct Deletion {
+    uint64_t frame;
+    std::function<void()> deleter;
+  };
+  std::atomic<uint64_t> frame_{0}; // written under deletionMutex_, read by currentFrame() without it
+  std::mutex deletionMutex_; // loader threads may release resources too
+  std::deque<Deletion> deletionQueue_;
+
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-  const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME
+  std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME
 #ifdef __APPLE__
       , "VK_KHR_portability_subset"
 #endif
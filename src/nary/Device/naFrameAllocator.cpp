@@ -0,0 +1,52 @@
+#include "naFrameAllocator.hpp"
+
+#include "se_tools.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace nary {
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+naFrameAllocator::naFrameAllocator(naDevice& device, VkDeviceSize frameSize, VkBufferUsageFlags usage)
+: m_UniformAlignment(std::max<VkDeviceSize>(device.properties.limits.minUniformBufferOffsetAlignment, 1)),
+  m_StorageAlignment(std::max<VkDeviceSize>(device.properties.limits.minStorageBufferOffsetAlignment, 1)) {
+    // every region starts at an offset that satisfies any alignment a descriptor needs, they are powers of two
+    auto regionAlignment = std::max({m_UniformAlignment, m_StorageAlignment, VkDeviceSize{16}});
+    m_FrameSize = align_up(frameSize, regionAlignment);
+
+    m_Buffer = std::make_unique<naBuffer>(device, m_FrameSize, naSwapChain::MAX_FRAMES_IN_FLIGHT, usage,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_Buffer->map(); // stays mapped for the whole lifetime
+}
+
+void naFrameAllocator::beginFrame(uint32_t frameIndex) {
+    m_FrameBegin = frameIndex * m_FrameSize;
+    m_Head = m_FrameBegin;
+    m_OverflowReported = false;
+}
+
+naFrameAllocator::Allocation naFrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    assert((alignment & (alignment - 1)) == 0 && "alignment must be a power of two");
+
+    auto offset = align_up(m_Head, alignment);
+    if (offset + size > m_FrameBegin + m_FrameSize) {
+        if (!m_OverflowReported)
+            ERROR_LOG("frame allocator is full, {} of {} bytes are used", getUsed(), m_FrameSize);
+        m_OverflowReported = true;
+        return {};
+    }
+    m_Head = offset + size;
+
+    Allocation allocation;
+    allocation.data = static_cast<char*>(m_Buffer->getMappedMemory()) + offset;
+    allocation.buffer = m_Buffer->getBuffer();
+    allocation.offset = offset;
+    allocation.size = size;
+    return allocation;
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "naDevice.hpp"
+#include "naBuffer.hpp"
+#include "naSwapChain.hpp"
+
+namespace nary {
+
+/**
+ * Scratch GPU memory for data that is written once per frame, e.g. instance matrices, light lists or UI vertices.
+ *
+ * One persistently mapped, coherent buffer is split into a region per frame in flight. Allocations bump a pointer
+ * through the current frame's region, which is reused once beginFrame() is called for the frame again,
+ * i.e. after its fence was waited for. Nothing is allocated per frame on the host or the device.
+ */
+class naFrameAllocator {
+public:
+    struct Allocation {
+        void* data = nullptr;           // mapped and coherent, write it before the frame is submitted
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;        // from the start of the buffer
+        VkDeviceSize size = 0;
+
+        explicit operator bool() const { return data != nullptr; }
+
+        /**
+         * for a *_DYNAMIC descriptor written with descriptorInfo(), the offsets are aligned for it
+         */
+        uint32_t dynamicOffset() const { return static_cast<uint32_t>(offset); }
+        /**
+         * for a regular descriptor, e.g. one written into a transient set
+         */
+        VkDescriptorBufferInfo descriptorInfo() const { return {buffer, offset, size}; }
+    };
+
+    /**
+     * @param frameSize bytes each frame in flight can allocate
+     */
+    naFrameAllocator(naDevice& device, VkDeviceSize frameSize,
+                     VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+    naFrameAllocator(const naFrameAllocator&) = delete;
+    naFrameAllocator& operator=(const naFrameAllocator&) = delete;
+
+    /**
+     * switches to the frame's region and frees everything allocated from it, the frame's fence has to be signaled
+     */
+    void beginFrame(uint32_t frameIndex);
+
+    /**
+     * @return an empty allocation if the frame's region is full
+     */
+    Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+    Allocation allocateUniform(VkDeviceSize size) { return allocate(size, m_UniformAlignment); }
+    Allocation allocateStorage(VkDeviceSize size) { return allocate(size, m_StorageAlignment); }
+
+    /**
+     * binds the whole buffer at offset 0, pass Allocation::dynamicOffset() when binding the set
+     * @param range the size the shader reads at each dynamic offset
+     */
+    VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const { return {m_Buffer->getBuffer(), 0, range}; }
+
+    VkBuffer getBuffer() const { return m_Buffer->getBuffer(); }
+    VkDeviceSize getFrameSize() const { return m_FrameSize; }
+    /**
+     * bytes allocated from the current frame's region, including alignment padding
+     */
+    VkDeviceSize getUsed() const { return m_Head - m_FrameBegin; }
+
+private:
+    VkDeviceSize m_UniformAlignment;
+    VkDeviceSize m_StorageAlignment;
+    VkDeviceSize m_FrameSize;
+    std::unique_ptr<naBuffer> m_Buffer;
+
+    VkDeviceSize m_FrameBegin = 0;
+    VkDeviceSize m_Head = 0;
+    bool m_OverflowReported = false; // once per frame
+
+};
+
+}
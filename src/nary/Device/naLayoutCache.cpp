@@ -0,0 +1,87 @@
+#include "naLayoutCache.hpp"
+
+#include "se_tools.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace nary {
+
+naLayoutCache::naLayoutCache(naDevice& device) : device(device) {}
+
+naLayoutCache::~naLayoutCache() {
+    for (auto& [key, layout] : pipelineLayouts)
+        vkDestroyPipelineLayout(device.device(), layout.layout, nullptr);
+}
+
+void naLayoutCache::registerShader(const ShaderReflection& reflection) {
+    std::lock_guard lock{mutex};
+    for (auto& b : reflection.bindings) {
+        if (!setLayouts.contains(b.set)) continue;
+        // a created layout can't change, the shader would access a binding its stage can't see
+        auto known = registered.find(b.set, b.binding);
+        if (!known || (known->stages & b.stages) != b.stages)
+            ERROR_LOG("set {} binding {} was registered after the layout of its set was created", b.set, b.binding);
+    }
+    registered.merge(reflection);
+}
+
+naDescriptorSetLayout* naLayoutCache::getSetLayout(uint32_t set) {
+    std::lock_guard lock{mutex};
+    return getSetLayoutLocked(set);
+}
+
+naDescriptorSetLayout* naLayoutCache::getSetLayoutLocked(uint32_t set) {
+    auto& layout = setLayouts[set];
+    if (layout) return layout.get();
+
+    naDescriptorSetLayout::Builder builder{device};
+    for (auto& b : registered.bindings) {
+        if (b.set != set) continue;
+        if (b.count != 0) {
+            builder.addBinding(b.binding, b.type, b.stages, b.count);
+            continue;
+        }
+        if (!device.supportsBindless())
+            throw std::runtime_error("set " + std::to_string(set) + " binding " + std::to_string(b.binding) +
+                                     " is a runtime sized array, which needs descriptor indexing");
+        // bindless, elements are written while the set is bound and the unwritten ones are never read
+        builder.addBinding(b.binding, b.type, b.stages, device.maxBindlessDescriptors(),
+                           VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                           VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT);
+    }
+    layout = builder.build();
+    return layout.get();
+}
+
+const naLayoutCache::PipelineLayout& naLayoutCache::getPipelineLayout(const ShaderReflection& reflection, uint32_t minSetCount) {
+    registerShader(reflection);
+
+    std::lock_guard lock{mutex};
+    auto& push = reflection.pushConstants;
+    auto setCount = std::max(reflection.setCount(), minSetCount);
+    auto [it, inserted] = pipelineLayouts.try_emplace({setCount, push.offset, push.size, push.stageFlags});
+    if (!inserted) return it->second;
+
+    // sets a pipeline doesn't use still get their layout, so the sets bound around it stay valid
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+    LOOP (setCount) descriptorSetLayouts.push_back(getSetLayoutLocked(i)->get());
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = push.size ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = push.size ? &push : nullptr;
+
+    auto& result = it->second;
+    result.pushConstants = push;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &result.layout) != VK_SUCCESS) {
+        pipelineLayouts.erase(it);
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+    return result;
+}
+
+}
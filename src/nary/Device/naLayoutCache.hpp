@@ -0,0 +1,57 @@
+#pragma once
+
+#include "naDescriptors.hpp"
+#include "naShaderReflection.hpp"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace nary {
+
+/**
+ * Creates descriptor set and pipeline layouts from reflected shaders and shares equal ones.
+ * A set index means the same thing to every shader, so its layout is made of the bindings all registered
+ * shaders declare in it, each with exactly the stages that use it. Sets bound once (e.g. the global ubo)
+ * therefore stay compatible with every pipeline layout.
+ * Runtime sized arrays become bindless bindings with naDevice::maxBindlessDescriptors() elements.
+ */
+class naLayoutCache {
+public:
+    struct PipelineLayout {
+        VkPipelineLayout layout;
+        VkPushConstantRange pushConstants; // its stageFlags are the ones vkCmdPushConstants needs
+    };
+
+    naLayoutCache(naDevice& device);
+    ~naLayoutCache();
+
+    naLayoutCache(const naLayoutCache&) = delete;
+    naLayoutCache& operator=(const naLayoutCache&) = delete;
+
+    /**
+     * adds the shader's bindings to the sets, register every shader before the layouts of its sets are created
+     */
+    void registerShader(const ShaderReflection& reflection);
+
+    naDescriptorSetLayout* getSetLayout(uint32_t set);
+    /**
+     * the reflection of all stages of a pipeline, it is registered first
+     * @param minSetCount sets the caller binds even if no stage uses them
+     */
+    const PipelineLayout& getPipelineLayout(const ShaderReflection& reflection, uint32_t minSetCount = 0);
+
+private:
+    naDescriptorSetLayout* getSetLayoutLocked(uint32_t set);
+
+    naDevice& device;
+
+    std::mutex mutex; // systems create their layouts on workers
+    ShaderReflection registered;
+    std::map<uint32_t, std::unique_ptr<naDescriptorSetLayout>> setLayouts;
+    // set count, push constant offset, size and stages
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t, VkShaderStageFlags>, PipelineLayout> pipelineLayouts;
+
+};
+
+}
@@ -24,6 +24,18 @@ naSwapChain::naSwapChain(
   oldSwapChain = nullptr;
 }
 
+void naSwapChain::adoptSyncObjects(naSwapChain &previous) {
+  // frames submitted through the previous swap chain signal these fences,
+  // waiting on them keeps working across the recreation without idling the device
+  imageAvailableSemaphores = std::move(previous.imageAvailableSemaphores);
+  renderFinishedSemaphores = std::move(previous.renderFinishedSemaphores);
+  inFlightFences = std::move(previous.inFlightFences);
+  currentFrame = previous.currentFrame;
+  previous.imageAvailableSemaphores.clear();
+  previous.renderFinishedSemaphores.clear();
+  previous.inFlightFences.clear();
+}
+
 void naSwapChain::init() {
   createSwapChain();
   createImageViews();
@@ -31,6 +43,8 @@ void naSwapChain::init() {
 //    createColorResources();
 //  createDepthResources();
   createFramebuffers();
+  if (oldSwapChain)
+    adoptSyncObjects(*oldSwapChain);
   createSyncObjects();
 }
 
@@ -63,8 +77,8 @@ naSwapChain::~naSwapChain() {
 
   vkDestroyRenderPass(device.device(), renderPass, nullptr);
 
-  // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  // cleanup synchronization objects, unless the next swap chain took them over
+  for (size_t i = 0; i < inFlightFences.size(); i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
     vkDestroyFence(device.device(), inFlightFences[i], nullptr);
@@ -90,6 +104,15 @@ VkResult naSwapChain::acquireNextImage(uint32_t *imageIndex) {
   return result;
 }
 
+void naSwapChain::waitForFrames() {
+  vkWaitForFences(
+      device.device(),
+      static_cast<uint32_t>(inFlightFences.size()),
+      inFlightFences.data(),
+      VK_TRUE,
+      std::numeric_limits<uint64_t>::max());
+}
+
 VkResult naSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex) {
   if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
     vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
@@ -343,10 +366,12 @@ void naSwapChain::createFramebuffers() {
 //}
 
 void naSwapChain::createSyncObjects() {
+  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+  if (!inFlightFences.empty()) return; // adopted from the previous swap chain
+
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -414,7 +439,7 @@ VkExtent2D naSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabil
   }
 }
 
-VkFormat naSwapChain::findDepthFormat() {
+VkFormat naSwapChain::findDepthFormat(naDevice &device) {
   return device.findSupportedFormat(
       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
       VK_IMAGE_TILING_OPTIMAL,
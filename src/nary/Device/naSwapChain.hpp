@@ -37,11 +37,17 @@ class naSwapChain {
   float extentAspectRatio() {
     return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
   }
-  VkFormat findDepthFormat();
+  VkFormat findDepthFormat() { return findDepthFormat(device); }
+  static VkFormat findDepthFormat(naDevice &device);
 
   VkResult acquireNextImage(uint32_t *imageIndex);
   VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
 
+  /**
+   * blocks until every submitted frame has finished
+   */
+  void waitForFrames();
+
   bool compareSwapFormats(const naSwapChain &swapChain) const {
     return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
            swapChain.swapChainImageFormat == swapChainImageFormat;
@@ -56,6 +62,7 @@ class naSwapChain {
   void createRenderPass();
   void createFramebuffers();
   void createSyncObjects();
+  void adoptSyncObjects(naSwapChain &previous);
 
   // Helper functions
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -0,0 +1,481 @@
+#include "naUploadManager.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace nary {
+
+naUploadManager::naUploadManager(naDevice& device, VkDeviceSize stagingSize)
+: device(device), m_RingSize(stagingSize) {
+    auto indices = device.findPhysicalQueueFamilies();
+    m_GraphicsFamily = indices.graphicsFamily;
+    m_TransferFamily = indices.transferFamily;
+    m_DedicatedTransfer = m_TransferFamily != m_GraphicsFamily;
+
+    // optimalBufferCopyOffsetAlignment is only a hint, but texel copies need at least 4 bytes anyway
+    m_CopyAlignment = std::max<VkDeviceSize>(16, device.properties.limits.optimalBufferCopyOffsetAlignment);
+
+    createCommandPools();
+    createStagingRing();
+}
+
+naUploadManager::~naUploadManager() {
+    waitIdle();
+
+    if (m_Current.fence != VK_NULL_HANDLE) // begun but never used
+        m_FreeBatches.push_back(std::move(m_Current));
+    for (auto& i : m_FreeBatches) {
+        vkDestroyFence(device.device(), i.fence, nullptr);
+        if (i.semaphore != VK_NULL_HANDLE)
+            vkDestroySemaphore(device.device(), i.semaphore, nullptr);
+    }
+    vkDestroyCommandPool(device.device(), m_TransferPool, nullptr);
+    if (m_GraphicsPool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(device.device(), m_GraphicsPool, nullptr);
+}
+
+void naUploadManager::createCommandPools() {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    poolInfo.queueFamilyIndex = m_TransferFamily;
+    if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &m_TransferPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    if (m_DedicatedTransfer) {
+        poolInfo.queueFamilyIndex = m_GraphicsFamily;
+        if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &m_GraphicsPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload command pool!");
+        }
+    }
+}
+
+void naUploadManager::createStagingRing() {
+    m_StagingRing = std::make_unique<naBuffer>(
+        device,
+        m_RingSize,
+        1,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+    m_StagingRing->map(); // stays mapped for the whole lifetime
+}
+
+void naUploadManager::beginBatch() {
+    if (m_Current.transferCmd != VK_NULL_HANDLE) return;
+
+    if (!m_FreeBatches.empty()) {
+        m_Current = std::move(m_FreeBatches.back());
+        m_FreeBatches.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        allocInfo.commandPool = m_TransferPool;
+        if (vkAllocateCommandBuffers(device.device(), &allocInfo, &m_Current.transferCmd) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+        if (m_DedicatedTransfer) {
+            allocInfo.commandPool = m_GraphicsPool;
+            if (vkAllocateCommandBuffers(device.device(), &allocInfo, &m_Current.graphicsCmd) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &m_Current.semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload semaphore!");
+            }
+        } else {
+            m_Current.graphicsCmd = m_Current.transferCmd;
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device.device(), &fenceInfo, nullptr, &m_Current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload fence!");
+        }
+    }
+
+    m_Current.ticket = m_NextTicket++;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(m_Current.transferCmd, &beginInfo);
+    if (m_DedicatedTransfer)
+        vkBeginCommandBuffer(m_Current.graphicsCmd, &beginInfo);
+}
+
+void naUploadManager::submitBatch() {
+    if (m_Current.empty) return;
+
+    if (!m_DedicatedTransfer && m_Current.buffersWritten) {
+        // the acquire barriers do this on the dedicated path
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(m_Current.transferCmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,
+                             1, &barrier,
+                             0, nullptr,
+                             0, nullptr);
+    }
+
+    vkEndCommandBuffer(m_Current.transferCmd);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_Current.transferCmd;
+
+    if (m_DedicatedTransfer) {
+        vkEndCommandBuffer(m_Current.graphicsCmd);
+
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_Current.semaphore;
+        if (vkQueueSubmit(device.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload batch!");
+        }
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquireInfo{};
+        acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireInfo.waitSemaphoreCount = 1;
+        acquireInfo.pWaitSemaphores = &m_Current.semaphore;
+        acquireInfo.pWaitDstStageMask = &waitStage;
+        acquireInfo.commandBufferCount = 1;
+        acquireInfo.pCommandBuffers = &m_Current.graphicsCmd;
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &acquireInfo, m_Current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload batch!");
+        }
+    } else {
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, m_Current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload batch!");
+        }
+    }
+
+    m_SubmittedTicket = m_Current.ticket;
+    m_InFlight.push_back(std::move(m_Current));
+    m_Current = {};
+}
+
+void naUploadManager::retireFront() {
+    auto& batch = m_InFlight.front();
+
+    m_RingTail = (m_RingTail + batch.ringBytes) % m_RingSize;
+    m_RingUsed -= batch.ringBytes;
+    if (m_RingUsed == 0)
+        m_RingHead = m_RingTail = 0;
+
+    m_CompletedTicket = batch.ticket;
+
+    vkResetFences(device.device(), 1, &batch.fence);
+    batch.oversized.clear();
+    batch.ringBytes = 0;
+    batch.empty = true;
+    batch.buffersWritten = false;
+    m_FreeBatches.push_back(std::move(batch));
+
+    m_InFlight.pop_front();
+}
+
+void naUploadManager::retireBatches(bool block) {
+    // batches finish in submission order, so only the front has to be checked
+    while (!m_InFlight.empty()) {
+        auto fence = m_InFlight.front().fence;
+        if (block)
+            vkWaitForFences(device.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+        else if (vkGetFenceStatus(device.device(), fence) != VK_SUCCESS)
+            break;
+        retireFront();
+    }
+}
+
+bool naUploadManager::allocateRing(VkDeviceSize size, VkDeviceSize& offset) {
+    offset = (m_RingHead + m_CopyAlignment - 1) / m_CopyAlignment * m_CopyAlignment;
+    auto padding = offset - m_RingHead;
+    if (offset + size > m_RingSize) {
+        // wrap around, the tail end of the ring is wasted until this batch retires
+        padding = m_RingSize - m_RingHead;
+        offset = 0;
+    }
+
+    auto need = padding + size;
+    if (m_RingUsed + need > m_RingSize)
+        return false;
+
+    m_RingHead = offset + size;
+    m_RingUsed += need;
+    m_Current.ringBytes += need;
+    return true;
+}
+
+std::pair<VkBuffer, VkDeviceSize> naUploadManager::stage(const void* data, VkDeviceSize size) {
+    VkDeviceSize offset;
+    if (allocateRing(size, offset) || (retireBatches(false), allocateRing(size, offset))) {
+        std::memcpy(static_cast<char*>(m_StagingRing->getMappedMemory()) + offset, data, size);
+        return {m_StagingRing->getBuffer(), offset};
+    }
+
+    // too large for the ring, or the ring is full of batches in flight:
+    // use a dedicated staging buffer instead of stalling
+    auto& staging = m_Current.oversized.emplace_back(naBuffer::createStagingBuffer(device, const_cast<void*>(data), size));
+    return {staging->getBuffer(), 0};
+}
+
+UploadTicket naUploadManager::uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+    std::lock_guard lock{m_Mutex};
+    beginBatch();
+
+    auto [srcBuffer, srcOffset] = stage(data, size);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(m_Current.transferCmd, srcBuffer, dstBuffer, 1, &copyRegion);
+
+    if (m_DedicatedTransfer) {
+        // queue family ownership transfer: release on the transfer queue...
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = m_TransferFamily;
+        barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+        barrier.buffer = dstBuffer;
+        barrier.offset = dstOffset;
+        barrier.size = size;
+        vkCmdPipelineBarrier(m_Current.transferCmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             1, &barrier,
+                             0, nullptr);
+
+        // ...and acquire on the graphics queue
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(m_Current.graphicsCmd,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,
+                             0, nullptr,
+                             1, &barrier,
+                             0, nullptr);
+    } else {
+        m_Current.buffersWritten = true;
+    }
+
+    m_Current.empty = false;
+    return m_Current.ticket;
+}
+
+UploadTicket naUploadManager::uploadImage(VkImage dstImage, VkFormat format, VkExtent2D extent, uint32_t mipLevels,
+                                          const void* data, VkDeviceSize size, bool generateMipmaps) {
+    if (generateMipmaps) {
+        // Check if image format supports linear blitting
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.physicalDevice(), format, &formatProperties);
+
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+            throw std::runtime_error("texture image format does not support linear blitting!");
+        }
+    }
+
+    std::lock_guard lock{m_Mutex};
+    beginBatch();
+
+    auto [srcBuffer, srcOffset] = stage(data, size);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = dstImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(m_Current.transferCmd,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = srcOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyBufferToImage(m_Current.transferCmd, srcBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    if (m_DedicatedTransfer) {
+        // blits need a graphics queue, hand the image over
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = m_TransferFamily;
+        barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(m_Current.transferCmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(m_Current.graphicsCmd,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+    }
+
+    if (generateMipmaps) {
+        recordMipmaps(m_Current.graphicsCmd, dstImage, extent, mipLevels);
+    } else {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(m_Current.graphicsCmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+    }
+
+    m_Current.empty = false;
+    return m_Current.ticket;
+}
+
+void naUploadManager::recordMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, uint32_t mipLevels) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.levelCount = 1;
+
+    int32_t mipWidth = extent.width;
+    int32_t mipHeight = extent.height;
+
+    for (uint32_t i = 1; i < mipLevels; i++) {
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+
+        vkCmdBlitImage(commandBuffer,
+                       image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit,
+                       VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+
+        if (mipWidth > 1) mipWidth /= 2;
+        if (mipHeight > 1) mipHeight /= 2;
+    }
+
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+}
+
+UploadTicket naUploadManager::flush() {
+    std::lock_guard lock{m_Mutex};
+    retireBatches(false);
+    submitBatch();
+    return m_SubmittedTicket;
+}
+
+bool naUploadManager::isComplete(UploadTicket ticket) {
+    std::lock_guard lock{m_Mutex};
+    retireBatches(false);
+    return ticket <= m_CompletedTicket;
+}
+
+void naUploadManager::wait(UploadTicket ticket) {
+    std::lock_guard lock{m_Mutex};
+    if (!m_Current.empty && ticket >= m_Current.ticket)
+        submitBatch();
+
+    while (m_CompletedTicket < ticket && !m_InFlight.empty()) {
+        auto fence = m_InFlight.front().fence;
+        vkWaitForFences(device.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+        retireFront();
+    }
+}
+
+void naUploadManager::waitIdle() {
+    std::lock_guard lock{m_Mutex};
+    submitBatch();
+    retireBatches(true);
+}
+
+}
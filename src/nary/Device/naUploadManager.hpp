@@ -0,0 +1,119 @@
+#pragma once
+
+#include "naDevice.hpp"
+#include "naBuffer.hpp"
+
+#include <deque>
+#include <mutex>
+
+namespace nary {
+
+/**
+ * identifies the batch an upload was recorded into, increases monotonically
+ */
+using UploadTicket = uint64_t;
+
+/**
+ * Batches resource uploads into few queue submissions.
+ *
+ * Source data is copied into a persistently mapped staging ring right away, the copies are recorded
+ * into the current batch and submitted by flush(). When the device exposes a transfer-only queue family,
+ * copies run on it and the ownership of the resources is released to the graphics family,
+ * mipmap generation and the final layout transitions always run on the graphics queue.
+ *
+ * upload*() may be called from any thread, flush() has to be called from the thread that submits to the
+ * graphics queue (the render thread).
+ */
+class naUploadManager {
+public:
+    naUploadManager(naDevice& device, VkDeviceSize stagingSize = 32 * 1024 * 1024);
+    ~naUploadManager();
+
+    naUploadManager(const naUploadManager&) = delete;
+    naUploadManager& operator=(const naUploadManager&) = delete;
+
+    /**
+     * copy `size` bytes of `data` into `dstBuffer` at `dstOffset`, the buffer needs TRANSFER_DST usage
+     */
+    UploadTicket uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+    /**
+     * upload the first mip level of a 2D color image created with TRANSFER_SRC | TRANSFER_DST usage and UNDEFINED layout.
+     * The remaining levels are blitted when `generateMipmaps` is set, the image ends up in SHADER_READ_ONLY_OPTIMAL layout
+     */
+    UploadTicket uploadImage(VkImage dstImage, VkFormat format, VkExtent2D extent, uint32_t mipLevels,
+                             const void* data, VkDeviceSize size, bool generateMipmaps);
+
+    /**
+     * submit the current batch
+     * @return ticket of the submitted batch, or of the last one when nothing was recorded
+     */
+    UploadTicket flush();
+
+    /**
+     * non-blocking, also releases the staging memory of every finished batch
+     */
+    bool isComplete(UploadTicket ticket);
+
+    /**
+     * block until the batch is done, flushes it if it's still recording
+     */
+    void wait(UploadTicket ticket);
+    void waitIdle();
+
+    bool hasDedicatedTransferQueue() const {return m_DedicatedTransfer;}
+
+private:
+    struct Batch {
+        UploadTicket ticket = 0;
+        VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCmd = VK_NULL_HANDLE; // same as transferCmd without a dedicated transfer queue
+        VkFence fence = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE; // transfer -> graphics
+        VkDeviceSize ringBytes = 0; // bytes (including padding) taken from the ring
+        std::vector<std::unique_ptr<naBuffer>> oversized; // staging buffers of uploads that didn't fit into the ring
+        bool empty = true;
+        bool buffersWritten = false;
+    };
+
+    void createCommandPools();
+    void createStagingRing();
+
+    void beginBatch();
+    void submitBatch();
+    void retireBatches(bool block);
+    void retireFront();
+
+    /**
+     * copy data into the staging memory of the current batch
+     * @return buffer and offset to copy from
+     */
+    std::pair<VkBuffer, VkDeviceSize> stage(const void* data, VkDeviceSize size);
+    bool allocateRing(VkDeviceSize size, VkDeviceSize& offset);
+
+    void recordMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, uint32_t mipLevels);
+
+    naDevice& device;
+
+    bool m_DedicatedTransfer = false;
+    uint32_t m_TransferFamily, m_GraphicsFamily;
+    VkCommandPool m_TransferPool = VK_NULL_HANDLE;
+    VkCommandPool m_GraphicsPool = VK_NULL_HANDLE;
+
+    std::unique_ptr<naBuffer> m_StagingRing;
+    VkDeviceSize m_RingSize;
+    VkDeviceSize m_RingHead = 0, m_RingTail = 0, m_RingUsed = 0;
+    VkDeviceSize m_CopyAlignment;
+
+    Batch m_Current;
+    std::deque<Batch> m_InFlight;
+    std::vector<Batch> m_FreeBatches; // recycled command buffers, fences and semaphores
+
+    UploadTicket m_NextTicket = 1;
+    UploadTicket m_SubmittedTicket = 0;
+    UploadTicket m_CompletedTicket = 0;
+
+    std::mutex m_Mutex;
+};
+
+}
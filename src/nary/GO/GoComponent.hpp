@@ -82,16 +82,16 @@ struct TransformComponent : public Component {
 
 struct MeshComponent : public Component {
     MeshComponent(naGameObject* obj) : Component(obj) {}
-    MeshComponent(naGameObject* obj, UID mesh_id) : Component(obj), mesh_id(mesh_id) {}
+    MeshComponent(naGameObject* obj, AssetRef mesh_id) : Component(obj), mesh_id(std::move(mesh_id)) {}
 
-    UID mesh_id;
+    AssetRef mesh_id; // keeps the mesh loaded, the default cube if empty
 };
 
 struct MaterialComponent : public Component {
     MaterialComponent(naGameObject* obj) : Component(obj) {}
-    MaterialComponent(naGameObject* obj, UID material_id) : Component(obj), material_id(material_id) {}
+    MaterialComponent(naGameObject* obj, AssetRef material_id) : Component(obj), material_id(std::move(material_id)) {}
 
-    UID material_id;
+    AssetRef material_id;
 };
 
 struct PointLightComponent : public Component {
@@ -1,4 +1,5 @@
 #include "Scene.hpp"
+#include "naProfiler.hpp"
 
 #include <cassert>
 #include <queue>
@@ -41,6 +42,8 @@ void SceneNode::changeParent(SceneNode* newParent) {
 }
 
 void Scene::Update() {
+    NARY_PROFILE_SCOPE("Scene::Update");
+
     std::queue<SceneNode*> que;
     que.push(&m_RootNode);
 
@@ -7,6 +7,7 @@
 
 #include "naPhysicsWorld.hpp"
 #include "naEventListener.hpp"
+#include "naProfiler.hpp"
 
 namespace nary {
 
@@ -46,9 +47,14 @@ void naPhysicsWorld::pickGameObjs(float dt, const naGameObject::Map& objs) {
 }
 
 void naPhysicsWorld::Update(float dt, naGameObject::Map& objs) {
+    NARY_PROFILE_SCOPE("naPhysicsWorld::Update");
+
     pickGameObjs(std::clamp(dt, 1e-8f, .1f), objs);
     
-    m_World.Step(dt);
+    {
+        NARY_PROFILE_SCOPE("naPhysicsWorld::Step");
+        m_World.Step(dt);
+    }
     
     for (auto& [id, phyobj] : m_Objs) {
         auto& go = objs.at(id);
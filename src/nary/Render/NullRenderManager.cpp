@@ -0,0 +1,104 @@
+#include "NullRenderManager.hpp"
+#include "naShadowSystem.hpp"
+#include "naRenderSystem.hpp"
+#include "naProfiler.hpp"
+
+#include "se_tools.h"
+
+#include <optional>
+
+namespace nary {
+
+DrawCounters& DrawCounters::operator+=(const DrawCounters& o) {
+    drawCalls += o.drawCalls;
+    materialBinds += o.materialBinds;
+    pipelineBinds += o.pipelineBinds;
+    vertices += o.vertices;
+    LOOP (passDrawCalls.size()) passDrawCalls[i] += o.passDrawCalls[i];
+    return *this;
+}
+
+NullRenderManager::NullRenderManager() {
+    m_RenderResource = std::make_unique<RenderResource>();
+    m_RenderScene = std::make_unique<RenderScene>();
+}
+
+void NullRenderManager::tick(const Scene& scene) {
+    NARY_PROFILE_SCOPE("NullRenderManager::tick");
+
+    m_DrawStream.clear();
+    m_FrameCounters = {};
+
+    m_RenderScene->Update(scene, *m_RenderResource);
+
+    {
+        NARY_PROFILE_SCOPE("NullRenderManager::record");
+        recordShadowPass();
+        recordForwardPass();
+        recordPointLightPass();
+        recordPostProcessPass();
+    }
+
+    m_TotalCounters += m_FrameCounters;
+    ++m_FrameCount;
+}
+
+// the passes mirror what naShadowSystem, naRenderSystem, naPointLightSystem and the post processing draw
+
+void NullRenderManager::recordShadowPass() {
+    auto count = naShadowSystem::getShadowCasterCount(*m_RenderScene);
+    for (size_t i = 0; i < count; ++i) {
+        auto& entity = m_RenderScene->m_DirectionalLightVisableEntities[i];
+        draw(RenderPassType::Shadow, invaild_uid, entity.model->getDrawCount());
+    }
+}
+
+void NullRenderManager::recordForwardPass() {
+    std::optional<UID> mtl, texture;
+    std::optional<uint32_t> variant;
+    for (auto& entity : m_RenderScene->m_VisableEntities) {
+        if (mtl != entity.material) {
+            mtl = entity.material;
+            auto& material = *m_RenderResource->getMaterial(*mtl);
+
+            auto key = naRenderSystem::selectVariant(material, *m_RenderScene).key();
+            if (variant != key) {
+                variant = key;
+                m_FrameCounters.pipelineBinds++;
+            }
+            // parameters come from the storage buffer, only a texture change rebinds set 2
+            if (texture != material.base_color_texture) {
+                texture = material.base_color_texture;
+                m_FrameCounters.materialBinds++;
+            }
+        }
+        draw(RenderPassType::Forward, entity.material, entity.model->getDrawCount());
+    }
+}
+
+void NullRenderManager::recordPointLightPass() {
+    auto num_lights = static_cast<uint32_t>(m_RenderScene->m_PointLights.size());
+    if (num_lights == 0) return;
+    draw(RenderPassType::PointLight, invaild_uid, 6, num_lights);
+}
+
+void NullRenderManager::recordPostProcessPass() {
+    draw(RenderPassType::PostProcess, invaild_uid, 6);
+}
+
+void NullRenderManager::draw(RenderPassType pass, UID material, uint32_t vertexCount, uint32_t instanceCount) {
+    m_DrawStream.push_back({pass, material, vertexCount, instanceCount});
+    m_FrameCounters.drawCalls++;
+    m_FrameCounters.vertices += static_cast<uint64_t>(vertexCount) * instanceCount;
+    m_FrameCounters.passDrawCalls[static_cast<size_t>(pass)]++;
+}
+
+RenderResource* NullRenderManager::getRenderResource() const {
+    return m_RenderResource.get();
+}
+
+const RenderScene& NullRenderManager::getRenderScene() const {
+    return *m_RenderScene;
+}
+
+}
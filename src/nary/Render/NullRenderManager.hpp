@@ -0,0 +1,78 @@
+#pragma once
+
+#include "RenderResource.hpp"
+#include "RenderScene.hpp"
+
+#include <array>
+#include <vector>
+
+namespace nary {
+
+enum class RenderPassType : uint8_t {
+    Shadow,
+    Forward,
+    PointLight,
+    PostProcess,
+    Count
+};
+
+struct DrawCall {
+    RenderPassType pass;
+    UID material;           // invaild_uid if the pass binds no material
+    uint32_t vertexCount;   // indices for indexed meshes
+    uint32_t instanceCount;
+};
+
+struct DrawCounters {
+    uint64_t drawCalls = 0;
+    uint64_t materialBinds = 0;
+    uint64_t pipelineBinds = 0;     // forward pass shader variant switches
+    uint64_t vertices = 0;
+    std::array<uint64_t, static_cast<size_t>(RenderPassType::Count)> passDrawCalls{};
+
+    DrawCounters& operator+=(const DrawCounters& o);
+};
+
+/**
+ * Null backend of RenderManager.
+ * Runs the same CPU work per frame (RenderScene update, culling, material grouping) and records
+ * the draw calls the systems would issue into a stream instead of command buffers, no Vulkan object is created.
+ */
+class NullRenderManager {
+public:
+    NullRenderManager();
+
+    NullRenderManager(const NullRenderManager&) = delete;
+    NullRenderManager& operator=(const NullRenderManager&) = delete;
+
+    void tick(const Scene& scene);
+
+    RenderResource* getRenderResource() const;
+    const RenderScene& getRenderScene() const;
+
+    /**
+     * draw calls of the last frame, in submission order
+     */
+    const std::vector<DrawCall>& getDrawStream() const {return m_DrawStream;}
+    const DrawCounters& getFrameCounters() const {return m_FrameCounters;}
+    const DrawCounters& getTotalCounters() const {return m_TotalCounters;}
+    uint64_t getFrameCount() const {return m_FrameCount;}
+
+private:
+    void recordShadowPass();
+    void recordForwardPass();
+    void recordPointLightPass();
+    void recordPostProcessPass();
+
+    void draw(RenderPassType pass, UID material, uint32_t vertexCount, uint32_t instanceCount = 1);
+
+    std::unique_ptr<RenderResource> m_RenderResource;
+    std::unique_ptr<RenderScene> m_RenderScene;
+
+    std::vector<DrawCall> m_DrawStream;
+    DrawCounters m_FrameCounters;
+    DrawCounters m_TotalCounters;
+    uint64_t m_FrameCount = 0;
+};
+
+}
@@ -12,37 +12,216 @@
 
 #include "se_tools.h"
 
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
 namespace nary {
-naPipeline::naPipeline(naDevice& device, const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo) : device(device){
-    createPipline(vertPath, fragPath, configInfo);
+
+std::mutex naPipeline::s_RegistryMutex;
+std::vector<naPipeline*> naPipeline::s_Registry;
+std::unordered_map<std::string, std::weak_ptr<naPipeline>> naPipeline::s_Cache;
+
+namespace {
+
+// serializes the state a pipeline is created from, pipelines with equal keys are interchangeable
+struct StateKeyWriter {
+    template <class T>
+    StateKeyWriter& add(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        return *this;
+    }
+    
+    // only for structs without padding
+    template <class T>
+    StateKeyWriter& add(const T* values, uint32_t count) {
+        if (values) LOOP (count) add(values[i]);
+        return *this;
+    }
+    
+    std::string key;
+};
+
+size_t hashSpirv(const ShaderSource_t& spirv) {
+    return std::hash<std::string_view>{}({reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(spirv[0])});
+}
+
+}
+
+naPipeline::naPipeline(naDevice& device, const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo,
+                       const ShaderPermutation& permutation)
+: device(device), vertPath(vertPath), fragPath(fragPath), permutation(permutation) {
+    copyConfigInfo(configInfo, config);
+    handles = createPipline();
+    
+    std::lock_guard lock{s_RegistryMutex};
+    s_Registry.push_back(this);
 }
 
 naPipeline::~naPipeline(){
-    vkDestroyShaderModule(device.device(), vertModule, nullptr);
-    vkDestroyShaderModule(device.device(), fragModule, nullptr);
-    vkDestroyPipeline(device.device(), graphicsPipeline, nullptr);
+    {
+        std::lock_guard lock{s_RegistryMutex};
+        std::erase(s_Registry, this);
+        // another thread may have put a new pipeline under the key already
+        if (auto it = s_Cache.find(key); !key.empty() && it != s_Cache.end() && it->second.expired())
+            s_Cache.erase(it);
+    }
+    destroyHandles(device, handles);
+}
+
+std::shared_ptr<naPipeline> naPipeline::create(naDevice& device, const std::string& vertPath, const std::string& fragPath,
+                                               const PipelineConfigInfo& configInfo, const ShaderPermutation& permutation) {
+    auto key = stateKey(device, vertPath, fragPath, configInfo, permutation);
+    {
+        std::lock_guard lock{s_RegistryMutex};
+        if (auto it = s_Cache.find(key); it != s_Cache.end())
+            if (auto pipeline = it->second.lock())
+                return pipeline;
+    }
+    
+    // created without the lock, systems build their pipelines in parallel
+    auto pipeline = std::make_shared<naPipeline>(device, vertPath, fragPath, configInfo, permutation);
+    
+    std::lock_guard lock{s_RegistryMutex};
+    auto& cached = s_Cache[key];
+    if (auto other = cached.lock())
+        return other; // lost the race, the new one is dropped
+    cached = pipeline;
+    pipeline->key = std::move(key);
+    return pipeline;
 }
 
-void naPipeline::createPipline(const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo){
-    createShaderModule(CompileShader(vertPath), &vertModule);
-    createShaderModule(CompileShader(fragPath), &fragModule);
+std::string naPipeline::stateKey(naDevice& device, const std::string& vertPath, const std::string& fragPath,
+                                 const PipelineConfigInfo& configInfo, const ShaderPermutation& permutation) {
+    // the compiled SPIR-V rather than the paths, so a reloaded shader gets new pipelines.
+    // a pipeline that is reloaded itself keeps its old key, which no request produces again until the shader goes back
+    StateKeyWriter w;
+    w.add(device.device())
+     .add(hashSpirv(ShaderCompiler::CompileShaderFromFile(ShaderCompileInfo{vertPath, permutation.defines})))
+     .add(hashSpirv(ShaderCompiler::CompileShaderFromFile(ShaderCompileInfo{fragPath, permutation.defines})));
+    for (auto& [id, value] : permutation.constants)
+        w.add(id).add(value);
+    
+    auto& c = configInfo;
+    w.add(c.bindingDescriptions.size()).add(c.bindingDescriptions.data(), static_cast<uint32_t>(c.bindingDescriptions.size()));
+    w.add(c.attributeDescriptions.size()).add(c.attributeDescriptions.data(), static_cast<uint32_t>(c.attributeDescriptions.size()));
+    
+    w.add(c.inputAssemblyInfo.topology).add(c.inputAssemblyInfo.primitiveRestartEnable);
+    
+    w.add(c.viewportInfo.viewportCount).add(c.viewportInfo.scissorCount)
+     .add(c.viewportInfo.pViewports, c.viewportInfo.viewportCount)
+     .add(c.viewportInfo.pScissors, c.viewportInfo.scissorCount);
+    
+    auto& r = c.rasterizationInfo;
+    w.add(r.depthClampEnable).add(r.rasterizerDiscardEnable).add(r.polygonMode).add(r.cullMode).add(r.frontFace)
+     .add(r.depthBiasEnable).add(r.depthBiasConstantFactor).add(r.depthBiasClamp).add(r.depthBiasSlopeFactor).add(r.lineWidth);
+    
+    auto& m = c.multisampleInfo;
+    w.add(m.rasterizationSamples).add(m.sampleShadingEnable).add(m.minSampleShading)
+     .add(m.pSampleMask, (m.rasterizationSamples + 31) / 32)
+     .add(m.alphaToCoverageEnable).add(m.alphaToOneEnable);
+    
+    auto& b = c.colorBlendInfo;
+    w.add(b.logicOpEnable).add(b.logicOp).add(b.attachmentCount).add(b.pAttachments, b.attachmentCount).add(b.blendConstants);
+    
+    auto& d = c.depthStencilInfo;
+    w.add(d.depthTestEnable).add(d.depthWriteEnable).add(d.depthCompareOp).add(d.depthBoundsTestEnable)
+     .add(d.stencilTestEnable).add(d.front).add(d.back).add(d.minDepthBounds).add(d.maxDepthBounds);
+    
+    w.add(c.dynamicStaticInfo.dynamicStateCount).add(c.dynamicStaticInfo.pDynamicStates, c.dynamicStaticInfo.dynamicStateCount);
+    
+    // pipelines for compatible render passes could be shared too, but the engine creates each pass once
+    w.add(c.pipelineLayout).add(c.renderPass).add(c.subpass);
+    return std::move(w.key);
+}
+
+void naPipeline::copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst) {
+    dst.bindingDescriptions = src.bindingDescriptions;
+    dst.attributeDescriptions = src.attributeDescriptions;
+    dst.viewportInfo = src.viewportInfo;
+    dst.inputAssemblyInfo = src.inputAssemblyInfo;
+    dst.rasterizationInfo = src.rasterizationInfo;
+    dst.multisampleInfo = src.multisampleInfo;
+    dst.colorBlendAttachment = src.colorBlendAttachment;
+    dst.colorBlendInfo = src.colorBlendInfo;
+    dst.depthStencilInfo = src.depthStencilInfo;
+    dst.dynamicStaticEnables = src.dynamicStaticEnables;
+    dst.dynamicStaticInfo = src.dynamicStaticInfo;
+    dst.pipelineLayout = src.pipelineLayout;
+    dst.renderPass = src.renderPass;
+    dst.subpass = src.subpass;
+    
+    // the create infos point into the config itself
+    if (src.colorBlendInfo.pAttachments == &src.colorBlendAttachment)
+        dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+    if (src.dynamicStaticInfo.pDynamicStates == src.dynamicStaticEnables.data())
+        dst.dynamicStaticInfo.pDynamicStates = dst.dynamicStaticEnables.data();
+}
+
+std::optional<naPipeline::Handles> naPipeline::reload() {
+    Handles newHandles;
+    try {
+        newHandles = createPipline();
+    } catch (const std::exception& e) {
+        ERROR_LOG("Failed to reload pipeline ({}, {}): {}", vertPath, fragPath, e.what());
+        return std::nullopt;
+    }
+    return std::exchange(handles, newHandles);
+}
+
+void naPipeline::forEachPipeline(const std::function<void(naPipeline&)>& fn) {
+    std::lock_guard lock{s_RegistryMutex};
+    for (auto i : s_Registry) fn(*i);
+}
+
+void naPipeline::destroyHandles(naDevice& device, const Handles& handles) {
+    vkDestroyShaderModule(device.device(), handles.vertModule, nullptr);
+    vkDestroyShaderModule(device.device(), handles.fragModule, nullptr);
+    vkDestroyPipeline(device.device(), handles.pipeline, nullptr);
+}
+
+naPipeline::Handles naPipeline::createPipline(){
+    Handles result{};
+    createShaderModule(CompileShader(vertPath, permutation.defines), &result.vertModule);
+    try {
+        createShaderModule(CompileShader(fragPath, permutation.defines), &result.fragModule);
+    } catch (...) {
+        vkDestroyShaderModule(device.device(), result.vertModule, nullptr);
+        throw;
+    }
+    
+    // constants that a stage doesn't declare are ignored, so both stages share them
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    std::vector<uint32_t> specializationData;
+    for (auto& [id, value] : permutation.constants) {
+        specializationEntries.push_back({id, static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+        specializationData.push_back(value);
+    }
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+    specializationInfo.pData = specializationData.data();
+    auto pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
     
     VkPipelineShaderStageCreateInfo shaderStages[2];
     shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = vertModule;
+    shaderStages[0].module = result.vertModule;
     shaderStages[0].pName = "main";
     shaderStages[0].flags = 0;
     shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo = pSpecializationInfo;
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = fragModule;
+    shaderStages[1].module = result.fragModule;
     shaderStages[1].pName = "main";
     shaderStages[1].flags = 0;
     shaderStages[1].pNext = nullptr;
-    shaderStages[1].pSpecializationInfo = nullptr;
+    shaderStages[1].pSpecializationInfo = pSpecializationInfo;
     
+    auto& configInfo = config;
     auto& bindingDescriptions = configInfo.bindingDescriptions;
     auto& attributeDescriptions = configInfo.attributeDescriptions;
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -72,14 +251,22 @@ void naPipeline::createPipline(const std::string& vertPath, const std::string& f
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     
-    if(vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS){
+    if(vkCreateGraphicsPipelines(device.device(), device.pipelineCache(), 1, &pipelineInfo, nullptr, &result.pipeline) != VK_SUCCESS){
+        vkDestroyShaderModule(device.device(), result.vertModule, nullptr);
+        vkDestroyShaderModule(device.device(), result.fragModule, nullptr);
         throw std::runtime_error("Failed to create graphics pipeline");
     }
     
+    return result;
+}
+
+ShaderReflection naPipeline::reflect(const std::string& vertPath, const std::string& fragPath, const ShaderDefines& defines) {
+    auto reflection = ShaderReflection::reflect(ShaderCompiler::CompileShaderFromFile(ShaderCompileInfo{vertPath, defines}));
+    return reflection.merge(ShaderReflection::reflect(ShaderCompiler::CompileShaderFromFile(ShaderCompileInfo{fragPath, defines})));
 }
 
-std::vector<char> naPipeline::CompileShader(const std::string& filename){
-    const auto& source = ShaderCompiler::CompileShaderFromFile(filename);
+std::vector<char> naPipeline::CompileShader(const std::string& filename, const ShaderDefines& defines){
+    const auto& source = ShaderCompiler::CompileShaderFromFile(ShaderCompileInfo{filename, defines});
     std::vector<char> result(source.size() * sizeof(source[0]));
     
     memcpy(result.data(), source.data(), result.size());
@@ -178,7 +365,7 @@ void naPipeline::enableAlphaBlending(PipelineConfigInfo& configInfo) {
 }
 
 void naPipeline::bind(VkCommandBuffer commandbuffer){
-    vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, handles.pipeline);
 }
 
 }
@@ -8,12 +8,19 @@
 #pragma once
 
 #include "naDevice.hpp"
+#include "naShaderCompiler.hpp"
+#include "naShaderReflection.hpp"
 
 #include <glslang/Public/ShaderLang.h>
 #include <glslang/SPIRV/GlslangToSpv.h>
 
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 namespace nary {
 struct PipelineConfigInfo{
@@ -37,29 +44,86 @@ struct PipelineConfigInfo{
     uint32_t subpass = 0;
 };
 
+/**
+ * A variant of a pipeline's shaders.
+ * Defines select code paths in the preprocessor and need their own compile,
+ * specialization constants are applied at pipeline creation from the same SPIR-V.
+ */
+struct ShaderPermutation {
+    ShaderDefines defines;
+    std::vector<std::pair<uint32_t, uint32_t>> constants; // constant_id, 32 bit value
+};
+
 class naPipeline {
 public:
-    naPipeline(naDevice& device, const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo);
+    struct Handles {
+        VkPipeline pipeline;
+        VkShaderModule vertModule, fragModule;
+    };
+    
+    naPipeline(naDevice& device, const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo,
+               const ShaderPermutation& permutation = {});
     ~naPipeline();
     
+    /**
+     * returns the live pipeline created from the same SPIR-V, permutation and fixed function state,
+     * render pass and subpass, and only creates one if there is none
+     */
+    static std::shared_ptr<naPipeline> create(naDevice& device, const std::string& vertPath, const std::string& fragPath,
+                                              const PipelineConfigInfo& configInfo, const ShaderPermutation& permutation = {});
+    
     naPipeline(const naPipeline&) = delete;
     naPipeline operator=(const naPipeline&) = delete;
     
     void bind(VkCommandBuffer commandbuffer);
     
+    const std::string& getVertPath() const {return vertPath;}
+    const std::string& getFragPath() const {return fragPath;}
+    const ShaderPermutation& getPermutation() const {return permutation;}
+    /**
+     * rebuilds the pipeline from the current shader files and returns the replaced handles,
+     * they may still be used by frames in flight so the caller decides when to destroy them.
+     * keeps the old pipeline if compiling fails.
+     * @note must not race with command recording
+     */
+    std::optional<Handles> reload();
+    
+    /**
+     * calls fn for every live pipeline
+     */
+    static void forEachPipeline(const std::function<void(naPipeline&)>& fn);
+    static void destroyHandles(naDevice& device, const Handles& handles);
+    
+    /**
+     * the interface of both stages, to get the pipeline layout from the device's layout cache
+     */
+    static ShaderReflection reflect(const std::string& vertPath, const std::string& fragPath, const ShaderDefines& defines = {});
+    
     static void defaultPiplineConfigInfo(PipelineConfigInfo& configInfo);
     static void enableAlphaBlending(PipelineConfigInfo& configInfo);
     
 private:
-    static std::vector<char> CompileShader(const std::string& path);
+    static std::vector<char> CompileShader(const std::string& path, const ShaderDefines& defines);
+    static void copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst);
+    static std::string stateKey(naDevice& device, const std::string& vertPath, const std::string& fragPath,
+                                const PipelineConfigInfo& configInfo, const ShaderPermutation& permutation);
     
-    void createPipline(const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo);
+    Handles createPipline();
     
     void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
     
     naDevice& device;
-    VkPipeline graphicsPipeline;
-    VkShaderModule vertModule, fragModule;
+    Handles handles;
+    
+    // kept to rebuild the pipeline when its shaders change
+    std::string vertPath, fragPath;
+    ShaderPermutation permutation;
+    PipelineConfigInfo config;
+    std::string key; // in s_Cache, empty if it wasn't created by create()
+    
+    static std::mutex s_RegistryMutex;
+    static std::vector<naPipeline*> s_Registry;
+    static std::unordered_map<std::string, std::weak_ptr<naPipeline>> s_Cache; // by stateKey()
     
 };
 }
@@ -6,6 +6,7 @@
 //
 
 #include "naShaderCompiler.hpp"
+#include "naThreadPool.hpp"
 
 #include "resource_path.h"
 
@@ -15,7 +16,13 @@
 #include <glslang/Public/ShaderLang.h>
 #include <glslang/SPIRV/GlslangToSpv.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 
 namespace nary {
 
@@ -151,100 +158,340 @@ ShaderType ShaderCompiler::find_type(const std::string& filename) {
     }
 }
 
-ShaderSource_t ShaderCompiler::CompileShaderCode(const std::string& code, ShaderType type) {
-    glslang::InitializeProcess();
+namespace {
+
+// glslang keeps global state, it is set up on first use and torn down at exit
+struct GlslangProcess {
+    GlslangProcess() {glslang::InitializeProcess();}
+    ~GlslangProcess() {glslang::FinalizeProcess();}
+};
+
+void initGlslang() {
+    static GlslangProcess process;
+    // the cache isn't tracked, a fresh checkout has no directory for it
+    [[maybe_unused]] static bool cacheDirectory = [] {
+        std::error_code ec;
+        std::filesystem::create_directories(res::shaderCachePath, ec);
+        return !ec;
+    }();
+}
+
+constexpr int DEFAULT_VERSION = 450;
+constexpr auto MESSAGES = EShMessages(EShMsgSpvRules|EShMsgVulkanRules);
+
+// bump it whenever the compile setup changes in a way the hash can't see (e.g. defaultResources)
+constexpr uint64_t CACHE_VERSION = 1;
+
+std::string read_file(const std::filesystem::path& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.good()) {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+    return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+}
+
+/**
+ * resolves #include "file" relative to the including file and #include <file> relative to res::shaderPath,
+ * shaders need `#extension GL_GOOGLE_include_directive : require` to use it
+ */
+class Includer : public glslang::TShader::Includer {
+public:
+    IncludeResult* includeLocal(const char* headerName, const char* includerName, size_t depth) override {
+        return include(res::fullname(res::shaderPath, includerName).parent_path() / headerName);
+    }
+
+    IncludeResult* includeSystem(const char* headerName, const char*, size_t) override {
+        return include(res::fullname(res::shaderPath, headerName));
+    }
+
+    void releaseInclude(IncludeResult* result) override {
+        if (result) {
+            delete static_cast<std::string*>(result->userData);
+            delete result;
+        }
+    }
+
+private:
+    static IncludeResult* include(const std::filesystem::path& path) {
+        if (!std::filesystem::exists(path)) return nullptr;
+        auto content = new std::string(read_file(path));
+        return new IncludeResult{path.string(), content->data(), content->size(), content};
+    }
+};
+
+// FNV-1a, only used to tell sources apart
+struct Hasher {
+    uint64_t value = 0xcbf29ce484222325;
+
+    Hasher& add(std::string_view data) {
+        for (unsigned char c : data) {
+            value ^= c;
+            value *= 0x100000001b3;
+        }
+        return add(static_cast<uint64_t>(data.size()));
+    }
+    Hasher& add(uint64_t data) {
+        LOOP (sizeof(data)) {
+            value ^= (data >> (i * 8)) & 0xff;
+            value *= 0x100000001b3;
+        }
+        return *this;
+    }
+};
+
+/**
+ * hashes the text of every file included by source, recursively and in order,
+ * an include that can't be found is hashed by its name so creating it later changes the key
+ */
+void hash_includes(Hasher& hasher, const std::string& source, const std::filesystem::path& dir, std::vector<std::filesystem::path>& visited) {
+    std::istringstream iss(source);
+    for (std::string line; std::getline(iss, line);) {
+        auto pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line.compare(pos, 8, "#include") != 0) continue;
+
+        auto open = line.find_first_of("\"<", pos + 8);
+        if (open == std::string::npos) continue;
+        auto close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        if (close == std::string::npos) continue;
+
+        auto name = line.substr(open + 1, close - open - 1);
+        auto path = line[open] == '"' ? dir / name : res::fullname(res::shaderPath, name);
+        hasher.add(name);
+
+        if (!std::filesystem::exists(path)) continue;
+        path = std::filesystem::weakly_canonical(path);
+        if (std::find(visited.begin(), visited.end(), path) != visited.end()) continue; // include guards
+        visited.push_back(path);
+
+        auto content = read_file(path);
+        hasher.add(content);
+        hash_includes(hasher, content, path.parent_path(), visited);
+    }
+}
+
+std::string to_hex(uint64_t value) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(value));
+    return hex;
+}
+
+// SPIR-V already loaded by this process, keyed by cache file name
+std::mutex s_MemoryCacheMutex;
+std::unordered_map<std::string, ShaderSource_t> s_MemoryCache;
+
+// s_MemoryCacheMutex must be held
+void forget_cached(const std::string& prefix) {
+    std::erase_if(s_MemoryCache, [&](auto& i) {return i.first.starts_with(res::shaderCachePath + prefix);});
+}
+
+// disk only, called without s_MemoryCacheMutex so parallel compiles don't wait on each other's I/O
+void remove_cached_files(const std::string& prefix) {
+    // a missing directory has nothing to remove
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it{res::shaderCachePath, ec}, end; !ec && it != end; it.increment(ec)) {
+        if (it->path().filename().string().starts_with(prefix)) {
+            std::error_code removeError;
+            std::filesystem::remove(it->path(), removeError);
+        }
+    }
+}
+
+}
+
+ShaderCompileInfo::ShaderCompileInfo(std::string filename, ShaderDefines defines)
+: filename(std::move(filename)), type(ShaderCompiler::find_type(this->filename)), defines(std::move(defines)) {}
+
+ShaderCompileInfo::ShaderCompileInfo(std::string filename, ShaderType type, ShaderDefines defines)
+: filename(std::move(filename)), type(type), defines(std::move(defines)) {}
+
+ShaderSource_t ShaderCompiler::CompileShaderCode(const std::string& code, ShaderType type, const std::string& filename, const ShaderDefines& defines) {
+    initGlslang();
     
     const char* code_cstr = code.c_str();
+    const char* name_cstr = filename.c_str();
     
-    // Create and compile the shader
+    // Create and compile the shader, every call has its own TShader so it can run on any thread
     glslang::TShader shader((EShLanguage)type);
-    shader.setStrings(&code_cstr, 1);
+    shader.setStringsWithLengthsAndNames(&code_cstr, nullptr, &name_cstr, 1);
+    
+    std::string preamble;
+    for (auto& define : defines) {
+        auto eq = define.find('=');
+        preamble += "#define " + (eq == std::string::npos ? define : define.substr(0, eq) + ' ' + define.substr(eq + 1)) + '\n';
+    }
+    shader.setPreamble(preamble.c_str());
     
     auto Resources = defaultResources();
+    Includer includer;
     
-    if (!shader.parse(&Resources, 450, true, EShMessages(EShMsgSpvRules|EShMsgVulkanRules))) {
+    if (!shader.parse(&Resources, DEFAULT_VERSION, true, MESSAGES, includer)) {
         ERROR_LOG("[Shader Compiler]: Compilation failed:\n{}", shader.getInfoLog());
+        throw std::runtime_error("Failed to compile shader: " + filename);
     }
     
     // 将glslang中间表示转换为SPIR-V
     ShaderSource_t spirv;
     glslang::GlslangToSpv(*shader.getIntermediate(), spirv);
     
-    // 释放内存并清理glslang库
-    glslang::FinalizeProcess();
-    
     return spirv;
 }
 
 ShaderSource_t ShaderCompiler::CompileShaderFromFile(const std::string& filename) {
-    if (CacheExist(filename)) {
-        return ReadCache(filename);
+    return CompileShaderFromFile(ShaderCompileInfo{filename});
+}
+
+ShaderSource_t ShaderCompiler::CompileShaderFromFile(const ShaderCompileInfo& info) {
+    auto source = read_file(res::fullname(res::shaderPath, info.filename));
+    auto key = cache_key(info, source);
+    if (auto cached = FindCache(info, key)) {
+        return *cached;
+    }
+    
+    auto spirv = CompileShaderCode(source, info.type, info.filename, info.defines);
+    CacheShader(info, key, spirv);
+    return spirv;
+}
+
+std::vector<ShaderSource_t> ShaderCompiler::CompileShadersFromFiles(const std::vector<ShaderCompileInfo>& infos, naThreadPool& threadPool) {
+    std::vector<ShaderSource_t> result(infos.size());
+    std::vector<std::string> sources(infos.size()), keys(infos.size());
+    
+    // hashing is cheap, only the misses go to the workers
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < infos.size(); ++i) {
+        sources[i] = read_file(res::fullname(res::shaderPath, infos[i].filename));
+        keys[i] = cache_key(infos[i], sources[i]);
+        if (auto cached = FindCache(infos[i], keys[i]))
+            result[i] = std::move(*cached);
+        else
+            misses.push_back(i);
     }
     
-    return RecompileShaderFromFile(filename);
+    std::vector<std::exception_ptr> errors(misses.size());
+    threadPool.parallelFor(misses.size(), threadPool.size(), [&](size_t begin, size_t end, size_t) {
+        for (auto j = begin; j < end; ++j) {
+            auto i = misses[j];
+            try {
+                result[i] = CompileShaderCode(sources[i], infos[i].type, infos[i].filename, infos[i].defines);
+                CacheShader(infos[i], keys[i], result[i]);
+            } catch (...) {
+                errors[j] = std::current_exception();
+            }
+        }
+    });
+    for (auto& e : errors)
+        if (e) std::rethrow_exception(e);
+    
+    INFO_LOG("[Shader Compiler]: {} shaders, {} compiled on {} threads", infos.size(), misses.size(), threadPool.size());
+    return result;
 }
 
 ShaderSource_t ShaderCompiler::RecompileShaderFromFile(const std::string& filename) {
-    const auto& source = CompileShaderFromFileWithoutCache(filename);
-    CacheShader(filename, source);
-    return source;
+    ShaderCompileInfo info{filename};
+    auto source = read_file(res::fullname(res::shaderPath, filename));
+    auto spirv = CompileShaderCode(source, info.type, filename);
+    CacheShader(info, cache_key(info, source), spirv);
+    return spirv;
 }
 
 ShaderSource_t ShaderCompiler::CompileShaderFromFileWithoutCache(const std::string& filename) {
-    std::ifstream ifs(res::fullname(res::shaderPath, filename));
-    if (!ifs.good()) {
-        throw std::runtime_error("Failed to open file: " + filename);
-    }
+    return CompileShaderCode(read_file(res::fullname(res::shaderPath, filename)), find_type(filename), filename);
+}
+
+std::string ShaderCompiler::cache_key(const ShaderCompileInfo& info, const std::string& source) {
+    Hasher hasher;
+    hasher.add(CACHE_VERSION)
+          .add(static_cast<uint64_t>(info.type))
+          .add(static_cast<uint64_t>(DEFAULT_VERSION))
+          .add(static_cast<uint64_t>(MESSAGES))
+          .add(source);
     
-    std::string source_code((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    std::vector<std::filesystem::path> visited;
+    hash_includes(hasher, source, res::fullname(res::shaderPath, info.filename).parent_path(), visited);
     
-    try {
-        return CompileShaderCode(source_code, find_type(filename));
-    } catch (const std::exception& e) {
-        ERROR_LOG("Failed to compile shader: {}", filename);
-    }
+    for (auto& define : info.defines)
+        hasher.add(define);
+    
+    return to_hex(hasher.value);
 }
 
-std::string ShaderCompiler::cached_filename(const std::string& filename) {
-    return res::shaderCachePath + st::base58::encode(filename);
+/**
+ * caches are named <base58 of filename>-<variant>.<key>, base58 has neither '-' nor '.'
+ * so the prefixes identify a shader and one of its stage/defines variants
+ */
+std::string ShaderCompiler::cached_prefix(const std::string& filename) {
+    return st::base58::encode(filename) + '-';
 }
 
-bool ShaderCompiler::CacheExist(const std::string& filename) {
-    return std::filesystem::exists(cached_filename(filename));
+std::string ShaderCompiler::cached_prefix(const ShaderCompileInfo& info) {
+    Hasher hasher;
+    hasher.add(static_cast<uint64_t>(info.type));
+    for (auto& define : info.defines)
+        hasher.add(define);
+    
+    return cached_prefix(info.filename) + to_hex(hasher.value) + '.';
 }
 
-void ShaderCompiler::CacheShader(const std::string& filename, const ShaderSource_t& source) {
-    std::ofstream ofs(cached_filename(filename), std::ios::binary);
-    ofs.write((char*)source.data(), source.size() * sizeof(source[0]));
+std::string ShaderCompiler::cached_filename(const ShaderCompileInfo& info, const std::string& key) {
+    return res::shaderCachePath + cached_prefix(info) + key;
 }
 
-ShaderSource_t ShaderCompiler::ReadCache(const std::string& filename) {
-    ShaderSource_t source;
-    std::ifstream ifs(cached_filename(filename), std::ios::ate | std::ios::binary);
-    if(ifs.good()) {
-        size_t fileSize = static_cast<size_t>(ifs.tellg());
-        std::vector<char> buffer(fileSize);
-        ifs.seekg(0);
-        ifs.read(buffer.data(), fileSize);
-        
-        source.resize(fileSize / sizeof(source[0]));
-        memcpy(source.data(), buffer.data(), fileSize);
-    } else {
-        ERROR_LOG("Failed to open cache file: {}", filename);
+std::optional<ShaderSource_t> ShaderCompiler::FindCache(const ShaderCompileInfo& info, const std::string& key) {
+    auto filename = cached_filename(info, key);
+    {
+        std::lock_guard lock{s_MemoryCacheMutex};
+        if (auto it = s_MemoryCache.find(filename); it != s_MemoryCache.end())
+            return it->second;
     }
+    
+    std::ifstream ifs(filename, std::ios::ate | std::ios::binary);
+    if (!ifs.good()) return std::nullopt;
+    
+    size_t fileSize = static_cast<size_t>(ifs.tellg());
+    ShaderSource_t source(fileSize / sizeof(ShaderSource_t::value_type));
+    ifs.seekg(0);
+    ifs.read(reinterpret_cast<char*>(source.data()), source.size() * sizeof(source[0]));
+    
+    std::lock_guard lock{s_MemoryCacheMutex};
+    s_MemoryCache[filename] = source;
     return source;
 }
 
+void ShaderCompiler::CacheShader(const ShaderCompileInfo& info, const std::string& key, const ShaderSource_t& source) {
+    auto prefix = cached_prefix(info);
+    auto filename = cached_filename(info, key);
+    
+    remove_cached_files(prefix); // older versions of this variant will never be hit again
+    {
+        std::ofstream ofs(filename, std::ios::binary);
+        ofs.write((char*)source.data(), source.size() * sizeof(source[0]));
+    }
+    
+    std::lock_guard lock{s_MemoryCacheMutex};
+    forget_cached(prefix);
+    s_MemoryCache[filename] = source;
+}
+
 void ShaderCompiler::DeleteCache(const std::string& filename) {
-    std::remove(cached_filename(filename).c_str());
+    auto prefix = cached_prefix(filename);
+    {
+        std::lock_guard lock{s_MemoryCacheMutex};
+        forget_cached(prefix);
+    }
+    remove_cached_files(prefix);
 }
 
 void ShaderCompiler::DeleteAllCaches() {
-    for (const auto& entry : std::filesystem::directory_iterator(res::shaderCachePath)) {
+    {
+        std::lock_guard lock{s_MemoryCacheMutex};
+        s_MemoryCache.clear();
+    }
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it{res::shaderCachePath, ec}, end; !ec && it != end; it.increment(ec)) {
         try {
-            std::filesystem::remove_all(entry.path());
+            std::filesystem::remove_all(it->path());
         } catch (const std::filesystem::filesystem_error& e) {
-            std::cerr << "Error deleting file " << entry.path() << ": " << e
+            std::cerr << "Error deleting file " << it->path() << ": " << e
 .what() << std::endl;
         }
     }
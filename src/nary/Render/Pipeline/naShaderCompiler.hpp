@@ -7,11 +7,14 @@
 
 #pragma once
 
+#include <optional>
 #include <vector>
 #include <string>
 
 namespace nary {
 
+class naThreadPool;
+
 enum class ShaderType {
     Vertex = 0,
     TessControl,
@@ -22,13 +25,37 @@ enum class ShaderType {
 };
 
 using ShaderSource_t = std::vector<uint32_t>;
+using ShaderDefines = std::vector<std::string>; // "NAME" or "NAME=VALUE"
+
+struct ShaderCompileInfo {
+    ShaderCompileInfo(std::string filename, ShaderDefines defines = {}); // the stage is deduced from the extension
+    ShaderCompileInfo(std::string filename, ShaderType type, ShaderDefines defines = {});
+    
+    std::string filename;
+    ShaderType type;
+    ShaderDefines defines;
+};
 
 class ShaderCompiler {
 public:
     ShaderCompiler() = delete; // Instance creation not allowed
     
-    static ShaderSource_t CompileShaderCode(const std::string& code, ShaderType type);
+    /**
+     * filename is used for error messages and to resolve #include "..."
+     */
+    static ShaderSource_t CompileShaderCode(const std::string& code, ShaderType type, const std::string& filename = "", const ShaderDefines& defines = {});
+    /**
+     * cached by a hash of the source, the compile options and every included file,
+     * a changed shader is always recompiled
+     */
     static ShaderSource_t CompileShaderFromFile(const std::string& filename);
+    static ShaderSource_t CompileShaderFromFile(const ShaderCompileInfo& info);
+    /**
+     * compiles the cache misses in parallel on the pool, results are in the order of infos
+     * and stay in memory so the pipelines created afterwards don't touch the disk
+     * @note don't call it from a worker of the same pool
+     */
+    static std::vector<ShaderSource_t> CompileShadersFromFiles(const std::vector<ShaderCompileInfo>& infos, naThreadPool& threadPool);
     static ShaderSource_t RecompileShaderFromFile(const std::string& filename);
     static ShaderSource_t CompileShaderFromFileWithoutCache(const std::string& filename);
     
@@ -38,11 +65,13 @@ public:
     static void DeleteAllCaches();
     
 private:
-    static std::string cached_filename(const std::string& filename);
+    static std::string cache_key(const ShaderCompileInfo& info, const std::string& source);
+    static std::string cached_prefix(const std::string& filename);
+    static std::string cached_prefix(const ShaderCompileInfo& info);
+    static std::string cached_filename(const ShaderCompileInfo& info, const std::string& key);
     
-    static bool CacheExist(const std::string& filename);
-    static void CacheShader(const std::string& filename, const ShaderSource_t& source);
-    static ShaderSource_t ReadCache(const std::string& filename);
+    static std::optional<ShaderSource_t> FindCache(const ShaderCompileInfo& info, const std::string& key);
+    static void CacheShader(const ShaderCompileInfo& info, const std::string& key, const ShaderSource_t& source);
 };
 
 }
@@ -0,0 +1,151 @@
+#include "naShaderHotReload.hpp"
+#include "naShaderCompiler.hpp"
+
+#include "resource_path.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace nary {
+
+namespace {
+
+// editors save in several steps, events closer than this are handled together
+constexpr auto DEBOUNCE = std::chrono::milliseconds(50);
+
+// every shader variant a live pipeline was built from
+std::vector<ShaderCompileInfo> usedShaders() {
+    std::vector<ShaderCompileInfo> shaders;
+    auto add = [&](const std::string& filename, const ShaderDefines& defines) {
+        auto same = [&](auto& i) {return i.filename == filename && i.defines == defines;};
+        if (std::none_of(shaders.begin(), shaders.end(), same))
+            shaders.emplace_back(filename, defines);
+    };
+    naPipeline::forEachPipeline([&](naPipeline& pipeline) {
+        add(pipeline.getVertPath(), pipeline.getPermutation().defines);
+        add(pipeline.getFragPath(), pipeline.getPermutation().defines);
+    });
+    return shaders;
+}
+
+std::string variantName(const ShaderCompileInfo& info) {
+    auto name = info.filename;
+    for (auto& define : info.defines)
+        name += ' ' + define;
+    return name;
+}
+
+size_t hashSpirv(const ShaderSource_t& spirv) {
+    return std::hash<std::string_view>{}({reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(spirv[0])});
+}
+
+}
+
+naShaderHotReload::naShaderHotReload(naDevice& device) : m_Device(device) {
+#ifdef __linux__
+    m_Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_Fd < 0 || inotify_add_watch(m_Fd, res::shaderPath, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        WARNING_LOG("shader hot reload disabled, failed to watch {}", res::shaderPath);
+        if (m_Fd >= 0) close(m_Fd);
+        m_Fd = -1;
+        return;
+    }
+    m_Thread = std::thread(&naShaderHotReload::watchLoop, this);
+#else
+    INFO_LOG("shader hot reload is only supported on Linux");
+#endif
+}
+
+naShaderHotReload::~naShaderHotReload() {
+    m_Stop = true;
+    if (m_Thread.joinable())
+        m_Thread.join();
+#ifdef __linux__
+    if (m_Fd >= 0) close(m_Fd);
+#endif
+}
+
+void naShaderHotReload::update() {
+    std::set<std::string> ready;
+    {
+        std::lock_guard lock{m_ReadyMutex};
+        ready.swap(m_Ready);
+    }
+
+    if (!ready.empty()) {
+        naPipeline::forEachPipeline([&](naPipeline& pipeline) {
+            if (!ready.contains(pipeline.getVertPath()) && !ready.contains(pipeline.getFragPath()))
+                return;
+            if (auto old = pipeline.reload())
+                m_Device.deferDestroy([&device = m_Device, handles = *old] {
+                    naPipeline::destroyHandles(device, handles);
+                });
+        });
+        for (auto& i : ready)
+            INFO_LOG("reloaded shader {}", i);
+    }
+}
+
+void naShaderHotReload::recompile() {
+    // a changed file can be included by any shader, the content hashed cache only recompiles the affected ones
+    for (auto& shader : usedShaders()) {
+        try {
+            auto hash = hashSpirv(ShaderCompiler::CompileShaderFromFile(shader));
+            auto [it, inserted] = m_SpirvHashes.try_emplace(variantName(shader), hash);
+            if (!inserted && it->second == hash)
+                continue;
+            it->second = hash;
+        } catch (const std::exception& e) {
+            ERROR_LOG("{}", e.what());
+            continue;
+        }
+
+        std::lock_guard lock{m_ReadyMutex};
+        m_Ready.insert(shader.filename);
+    }
+}
+
+void naShaderHotReload::watchLoop() {
+#ifdef __linux__
+    // remember what every shader compiles to, so only real changes trigger a reload
+    for (auto& shader : usedShaders()) {
+        try {
+            m_SpirvHashes[variantName(shader)] = hashSpirv(ShaderCompiler::CompileShaderFromFile(shader));
+        } catch (const std::exception&) {}
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    std::set<std::string> changed;
+    auto lastEvent = std::chrono::steady_clock::now();
+
+    while (!m_Stop) {
+        pollfd pfd{m_Fd, POLLIN, 0};
+        if (poll(&pfd, 1, 20) > 0) {
+            ssize_t len;
+            while ((len = read(m_Fd, buffer, sizeof(buffer))) > 0) {
+                for (char* p = buffer; p < buffer + len;) {
+                    auto event = reinterpret_cast<const inotify_event*>(p);
+                    if (event->len && !(event->mask & IN_ISDIR))
+                        changed.insert(event->name);
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+            lastEvent = std::chrono::steady_clock::now();
+        }
+
+        if (!changed.empty() && std::chrono::steady_clock::now() - lastEvent > DEBOUNCE) {
+            recompile();
+            changed.clear();
+        }
+    }
+#endif
+}
+
+}
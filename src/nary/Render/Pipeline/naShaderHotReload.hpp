@@ -0,0 +1,52 @@
+#pragma once
+
+#include "naPipeline.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace nary {
+
+/**
+ * Watches res::shaderPath (inotify, Linux only) and recompiles changed shaders on a background thread.
+ * The pipelines using them are rebuilt by update() at a frame boundary, the replaced ones go to the
+ * device's deletion queue, so no device wait is needed.
+ * A shader that fails to compile keeps the old pipeline running.
+ */
+class naShaderHotReload {
+public:
+    explicit naShaderHotReload(naDevice& device);
+    ~naShaderHotReload();
+
+    naShaderHotReload(const naShaderHotReload&) = delete;
+    naShaderHotReload& operator=(const naShaderHotReload&) = delete;
+
+    /**
+     * call once per frame after the frame's fence was waited on and before recording
+     */
+    void update();
+
+    bool isWatching() const {return m_Thread.joinable();}
+
+private:
+    void watchLoop();
+    void recompile();
+
+    naDevice& m_Device;
+
+    int m_Fd = -1;
+    std::thread m_Thread;
+    std::atomic<bool> m_Stop{false};
+
+    // watcher thread only, hash of the SPIR-V each shader variant produced last time
+    std::unordered_map<std::string, size_t> m_SpirvHashes;
+
+    std::mutex m_ReadyMutex;
+    std::set<std::string> m_Ready; // recompiled shaders whose pipelines wait for update()
+};
+
+}
@@ -0,0 +1,355 @@
+#include "naShaderReflection.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace nary {
+
+namespace {
+
+// the parts of the SPIR-V spec the reflection reads
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr size_t HEADER_WORDS = 5;
+
+enum Op : uint32_t {
+    OpEntryPoint = 15,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpSpecConstant = 50,
+    OpSpecConstantOp = 52,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+};
+
+enum Decoration : uint32_t {
+    BufferBlock = 3,
+    ArrayStride = 6,
+    MatrixStride = 7,
+    Binding = 33,
+    DescriptorSet = 34,
+    Offset = 35,
+};
+
+enum StorageClass : uint32_t {
+    UniformConstant = 0,
+    Uniform = 2,
+    PushConstant = 9,
+    StorageBuffer = 12,
+};
+
+enum Dim : uint32_t {
+    DimBuffer = 5,
+    DimSubpassData = 6,
+};
+
+constexpr uint32_t NONE = ~0u;
+
+struct Member {
+    uint32_t type = 0;
+    uint32_t offset = 0;
+    uint32_t matrixStride = 0;
+};
+
+// everything known about a result id
+struct Id {
+    uint32_t opcode = 0;
+    uint32_t type = 0;          // pointee, element, component or column type, type of a variable or constant
+    uint32_t storageClass = 0;
+    uint32_t count = 0;         // components, columns or the id of an array's length
+    uint32_t value = 0;         // constants
+    uint32_t width = 0;         // scalars
+    uint32_t dim = 0;           // images
+    uint32_t sampled = 0;
+    uint32_t arrayStride = 0;
+    uint32_t set = NONE;
+    uint32_t binding = NONE;
+    bool bufferBlock = false;
+    std::vector<Member> members;
+};
+
+VkShaderStageFlags stage_of(uint32_t executionModel) {
+    switch (executionModel) {
+        case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+        default: return 0;
+    }
+}
+
+class Parser {
+public:
+    explicit Parser(const ShaderSource_t& spirv) : spirv(spirv) {
+        if (spirv.size() < HEADER_WORDS || spirv[0] != SPIRV_MAGIC)
+            throw std::runtime_error("failed to reflect shader: not SPIR-V");
+        ids.resize(spirv[3]); // id bound
+    }
+
+    ShaderReflection parse() {
+        for (size_t i = HEADER_WORDS; i < spirv.size();) {
+            uint32_t words = spirv[i] >> 16;
+            if (words == 0 || i + words > spirv.size())
+                throw std::runtime_error("failed to reflect shader: truncated instruction");
+            instruction(spirv[i] & 0xffff, &spirv[i + 1], words - 1);
+            i += words;
+        }
+
+        // decorations come before the types, so variables are resolved once everything is read
+        ShaderReflection reflection;
+        reflection.stages = stages;
+        for (auto& var : ids) {
+            if (var.opcode != OpVariable) continue;
+            if (var.storageClass == PushConstant)
+                pushConstant(reflection, var);
+            else if (var.set != NONE && var.binding != NONE)
+                reflection.bindings.push_back(binding(var));
+        }
+        std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](auto& a, auto& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+        return reflection;
+    }
+
+private:
+    Id& id(uint32_t i) {
+        if (i >= ids.size())
+            throw std::runtime_error("failed to reflect shader: id out of bound");
+        return ids[i];
+    }
+
+    void instruction(uint32_t opcode, const uint32_t* op, uint32_t n) {
+        switch (opcode) {
+            case OpEntryPoint:
+                stages |= stage_of(op[0]);
+                break;
+            case OpTypeInt:
+            case OpTypeFloat:
+                id(op[0]).opcode = opcode;
+                id(op[0]).width = op[1];
+                break;
+            case OpTypeVector:
+            case OpTypeMatrix:
+                id(op[0]).opcode = opcode;
+                id(op[0]).type = op[1];
+                id(op[0]).count = op[2];
+                break;
+            case OpTypeImage:
+                id(op[0]).opcode = opcode;
+                id(op[0]).dim = op[2];
+                id(op[0]).sampled = op[6];
+                break;
+            case OpTypeSampler:
+                id(op[0]).opcode = opcode;
+                break;
+            case OpTypeSampledImage:
+            case OpTypeRuntimeArray:
+                id(op[0]).opcode = opcode;
+                id(op[0]).type = op[1];
+                break;
+            case OpTypeArray:
+                id(op[0]).opcode = opcode;
+                id(op[0]).type = op[1];
+                id(op[0]).count = op[2];
+                break;
+            case OpTypeStruct: {
+                auto& s = id(op[0]);
+                s.opcode = opcode;
+                s.members.resize(n - 1);
+                for (uint32_t i = 1; i < n; ++i) s.members[i - 1].type = op[i];
+                break;
+            }
+            case OpTypePointer:
+                id(op[0]).opcode = opcode;
+                id(op[0]).storageClass = op[1];
+                id(op[0]).type = op[2];
+                break;
+            case OpConstant:
+            case OpSpecConstant:
+                id(op[1]).opcode = opcode;
+                id(op[1]).value = op[2];
+                break;
+            case OpSpecConstantOp:
+                id(op[1]).opcode = opcode;
+                break;
+            case OpVariable:
+                id(op[1]).opcode = opcode;
+                id(op[1]).type = op[0];
+                id(op[1]).storageClass = op[2];
+                break;
+            case OpDecorate:
+                decorate(id(op[0]), op[1], n > 2 ? op[2] : 0);
+                break;
+            case OpMemberDecorate: {
+                // members are decorated before the struct is declared
+                auto& s = id(op[0]).members;
+                if (s.size() <= op[1]) s.resize(op[1] + 1);
+                if (op[2] == Offset) s[op[1]].offset = op[3];
+                if (op[2] == MatrixStride) s[op[1]].matrixStride = op[3];
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    static void decorate(Id& target, uint32_t decoration, uint32_t literal) {
+        switch (decoration) {
+            case BufferBlock: target.bufferBlock = true; break;
+            case ArrayStride: target.arrayStride = literal; break;
+            case Binding: target.binding = literal; break;
+            case DescriptorSet: target.set = literal; break;
+            default: break;
+        }
+    }
+
+    ShaderBinding binding(Id& var) {
+        auto* type = &id(id(var.type).type); // variables are pointers
+        uint32_t count = 1;
+        while (type->opcode == OpTypeArray || type->opcode == OpTypeRuntimeArray) {
+            count = type->opcode == OpTypeArray ? count * length(*type, var) : 0;
+            type = &id(type->type);
+        }
+
+        ShaderBinding result{var.set, var.binding, VK_DESCRIPTOR_TYPE_MAX_ENUM, count, stages};
+        switch (type->opcode) {
+            case OpTypeSampledImage:
+                result.type = id(type->type).dim == DimBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                                                              : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                break;
+            case OpTypeImage:
+                if (type->dim == DimSubpassData)
+                    result.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                else if (type->dim == DimBuffer)
+                    result.type = type->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                else
+                    result.type = type->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                break;
+            case OpTypeSampler:
+                result.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+                break;
+            case OpTypeStruct:
+                if (var.storageClass == StorageBuffer || type->bufferBlock)
+                    result.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                else if (var.storageClass == Uniform)
+                    result.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                break;
+            default:
+                break;
+        }
+        if (result.type == VK_DESCRIPTOR_TYPE_MAX_ENUM)
+            throw std::runtime_error("failed to reflect shader: unsupported resource at set " +
+                                     std::to_string(var.set) + " binding " + std::to_string(var.binding));
+        return result;
+    }
+
+    // an array sized by a specialization constant gets its default value, the layouts are created before
+    // any pipeline specializes it. Lengths computed by OpSpecConstantOp can't be known here
+    uint32_t length(Id& array, Id& var) {
+        auto& constant = id(array.count);
+        if (constant.opcode != OpConstant && constant.opcode != OpSpecConstant)
+            throw std::runtime_error("failed to reflect shader: the array at set " + std::to_string(var.set) +
+                                     " binding " + std::to_string(var.binding) + " has a computed length");
+        return constant.value;
+    }
+
+    void pushConstant(ShaderReflection& reflection, Id& var) {
+        auto& block = id(id(var.type).type);
+        uint32_t begin = NONE, end = 0;
+        for (auto& m : block.members) {
+            begin = std::min(begin, m.offset);
+            end = std::max(end, m.offset + size_of(id(m.type), m.matrixStride));
+        }
+        if (begin >= end) return;
+        reflection.pushConstants = {stages, begin, end - begin};
+    }
+
+    uint32_t size_of(Id& type, uint32_t matrixStride = 0) {
+        switch (type.opcode) {
+            case OpTypeInt:
+            case OpTypeFloat:
+                return type.width / 8;
+            case OpTypeVector:
+                return type.count * size_of(id(type.type));
+            case OpTypeMatrix:
+                return type.count * (matrixStride ? matrixStride : size_of(id(type.type)));
+            case OpTypeArray: {
+                auto length = id(type.count).value; // specialization constants have their default value
+                return length * (type.arrayStride ? type.arrayStride : size_of(id(type.type), matrixStride));
+            }
+            case OpTypeStruct: {
+                uint32_t size = 0;
+                for (auto& m : type.members)
+                    size = std::max(size, m.offset + size_of(id(m.type), m.matrixStride));
+                return size;
+            }
+            default:
+                return 0;
+        }
+    }
+
+    const ShaderSource_t& spirv;
+    std::vector<Id> ids;
+    VkShaderStageFlags stages = 0;
+};
+
+}
+
+ShaderReflection ShaderReflection::reflect(const ShaderSource_t& spirv) {
+    return Parser{spirv}.parse();
+}
+
+ShaderReflection& ShaderReflection::merge(const ShaderReflection& other) {
+    for (auto& b : other.bindings) {
+        auto it = std::lower_bound(bindings.begin(), bindings.end(), b, [](auto& a, auto& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+        if (it == bindings.end() || it->set != b.set || it->binding != b.binding) {
+            bindings.insert(it, b);
+        } else if (it->type != b.type || it->count != b.count) {
+            throw std::runtime_error("set " + std::to_string(b.set) + " binding " + std::to_string(b.binding) +
+                                     " is declared with different types");
+        } else {
+            it->stages |= b.stages;
+        }
+    }
+
+    if (other.pushConstants.size) {
+        if (pushConstants.size) {
+            auto end = std::max(pushConstants.offset + pushConstants.size, other.pushConstants.offset + other.pushConstants.size);
+            pushConstants.offset = std::min(pushConstants.offset, other.pushConstants.offset);
+            pushConstants.size = end - pushConstants.offset;
+            pushConstants.stageFlags |= other.pushConstants.stageFlags;
+        } else {
+            pushConstants = other.pushConstants;
+        }
+    }
+
+    stages |= other.stages;
+    return *this;
+}
+
+const ShaderBinding* ShaderReflection::find(uint32_t set, uint32_t binding) const {
+    for (auto& b : bindings)
+        if (b.set == set && b.binding == binding) return &b;
+    return nullptr;
+}
+
+uint32_t ShaderReflection::setCount() const {
+    return bindings.empty() ? 0 : bindings.back().set + 1;
+}
+
+}
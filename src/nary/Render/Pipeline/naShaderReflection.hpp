@@ -0,0 +1,42 @@
+#pragma once
+
+#include "naShaderCompiler.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace nary {
+
+struct ShaderBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count;             // 0 for runtime sized arrays
+    VkShaderStageFlags stages;
+};
+
+/**
+ * The resource interface of one or more shader stages, read from their SPIR-V.
+ */
+struct ShaderReflection {
+    std::vector<ShaderBinding> bindings;    // sorted by set and binding
+    VkPushConstantRange pushConstants{};    // size is 0 if no stage declares a push constant block
+    VkShaderStageFlags stages = 0;
+
+    static ShaderReflection reflect(const ShaderSource_t& spirv);
+
+    /**
+     * adds the bindings of other, a binding declared by both gets the stages of both
+     * @note throws if the same binding is declared with different types
+     */
+    ShaderReflection& merge(const ShaderReflection& other);
+
+    const ShaderBinding* find(uint32_t set, uint32_t binding) const;
+    /**
+     * highest set used + 1
+     */
+    uint32_t setCount() const;
+};
+
+}
@@ -1,77 +1,204 @@
 #include "RenderManager.hpp"
+#include "naUploadManager.hpp"
+#include "naProfiler.hpp"
+#include "naShaderCompiler.hpp"
+#include "naLayoutCache.hpp"
+
+#include <chrono>
+#include <future>
 
 namespace nary {
 
 UID ui_texture;
 
-RenderManager::RenderManager(naWin& window) : m_Window(window) {
+// chunks smaller than this are recorded by a single thread, waking workers up costs more than it saves
+constexpr size_t MIN_DRAWS_PER_SECONDARY = 128;
+
+RenderManager::RenderManager(naWin& window) : m_Window(&window) {
     initialize();
-    createDescriptorSets();
+}
+
+RenderManager::RenderManager(VkExtent2D extent) {
+    initialize(extent);
 }
 
 RenderManager::~RenderManager() {
-    vkDeviceWaitIdle(m_Device->device());
+    // every queue submission is a frame, an upload batch or a single time command that waits for itself
+    m_Renderer->waitForFrames();
+    m_Device->uploader().waitIdle();
+    m_Device->flushDeletionQueue();
 }
 
-void RenderManager::initialize() {
-    m_Device = std::make_unique<naDevice>(m_Window);
-    m_Renderer = std::make_unique<naRenderer>(m_Window, *m_Device);
+void RenderManager::initialize(VkExtent2D extent) {
+    if (m_Window) {
+        m_Device = std::make_unique<naDevice>(*m_Window);
+        m_Renderer = std::make_unique<naRenderer>(*m_Window, *m_Device);
+    } else {
+        m_Device = std::make_unique<naDevice>();
+        m_Renderer = std::make_unique<naRenderer>(*m_Device, extent);
+    }
+
+    m_ThreadPool = std::make_unique<naThreadPool>();
+    m_Recorder = std::make_unique<naParallelRecorder>(*m_Device, *m_ThreadPool);
+    m_GpuProfiler = std::make_unique<naGpuProfiler>(*m_Device);
+
+    // compare the first run against later ones to see what the pipeline cache saves
+    auto pipelinesBegin = std::chrono::steady_clock::now();
+
+    // every shader used at startup, the cold misses are compiled in parallel and kept in memory for the pipelines below
+    ForwardVariant forward;
+    forward.bindless = m_Device->supportsBindless();
+    auto shaders = ShaderCompiler::CompileShadersFromFiles({
+        {"vertex.vert", forward.permutation().defines}, {"fragment.frag", forward.permutation().defines},
+        {"point_light_vertex.vert"}, {"point_light_fragment.frag"},
+        {"shadow.vert"}, {"shadow.frag"},
+        {"rectangle.vert"}, {"FXAA.frag"}
+    }, *m_ThreadPool);
+    // the set layouts get the stages of all of them, so they must be known before the first layout is created
+    for (auto& i : shaders)
+        m_Device->layoutCache().registerShader(ShaderReflection::reflect(i));
 
     m_RenderResource = std::make_unique<RenderResource>(*m_Device);
     m_RenderScene = std::make_unique<RenderScene>();
 
-    m_RenderSystem = std::make_unique<naRenderSystem>(*m_Device, m_Renderer->getRenderPass(), *m_RenderResource);
-    m_PointLightSystem = std::make_unique<naPointLightSystem>(*m_Device, m_Renderer->getRenderPass(), *m_RenderResource);
-    m_ShadowSystem = std::make_unique<naShadowSystem>(*m_Device, m_Renderer->getRenderPass(), *m_RenderResource);
+    // pipeline creation is thread safe and the pipeline cache is internally synchronized,
+    // so each system builds its pipeline on a worker
+    std::vector<std::future<void>> systems;
+    systems.push_back(m_ThreadPool->submit([&] {
+        m_RenderSystem = std::make_unique<naRenderSystem>(*m_Device, m_Renderer->getRenderPass(), *m_RenderResource);
+    }));
+    systems.push_back(m_ThreadPool->submit([&] {
+        m_PointLightSystem = std::make_unique<naPointLightSystem>(*m_Device, m_Renderer->getRenderPass(), *m_RenderResource);
+    }));
+    systems.push_back(m_ThreadPool->submit([&] {
+        m_ShadowSystem = std::make_unique<naShadowSystem>(*m_Device, m_Renderer->getRenderPass(), *m_RenderResource);
+    }));
+    systems.push_back(m_ThreadPool->submit([&] {
+        m_PostProcessing = std::make_unique<naRenderShaderOnly>(*m_Device, m_Renderer->getSwapChainRenderPass(), *m_RenderResource);
+        m_PostProcessing->setShaders("rectangle.vert", "FXAA.frag");
+    }));
+    // wait for all of them before rethrowing, the jobs capture locals by reference
+    for (auto& i : systems) i.wait();
+    for (auto& i : systems) i.get();
+
+    // only interactive sessions iterate on shaders
+    if (m_Window)
+        m_ShaderHotReload = std::make_unique<naShaderHotReload>(*m_Device);
 
-    m_PostProcessing = std::make_unique<naRenderShaderOnly>(*m_Device, m_Renderer->getSwapChainRenderPass(), *m_RenderResource);
-    m_PostProcessing->setShaders("rectangle.vert", "FXAA.frag");
+    // ImGui needs glfw for input
+    if (m_Window) {
+        m_UI = std::make_unique<naUISystem>(*m_Device, m_Renderer->getSwapChainRenderPass(), *m_Window);
+        m_UI->beginFrame();
+    }
 
-    m_UI = std::make_unique<naUISystem>(*m_Device, m_Renderer->getSwapChainRenderPass(), m_Window);
-    m_UI->beginFrame();
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelinesBegin).count();
+    INFO_LOG("render systems and pipelines created in {} ms", ms);
 }
 
-void RenderManager::createDescriptorSets() {
-    LOOP (naSwapChain::MAX_FRAMES_IN_FLIGHT) {
-        naSampler sampler{*m_Device, SamplerType::Linear};
-        auto offscreenInfo = sampler.descriptorInfo(m_Renderer->getFrameBuffer().getGroup(i).images[2]);
-        auto shadowMapInfo = sampler.descriptorInfo(m_Renderer->getFrameBuffer().getGroup(i).images[3]);
-        naDescriptorWriter{*m_RenderResource->getOneImageSetLayout(), *m_RenderResource->getDescriptorPool()}
-            .writeImage(0, &offscreenInfo)
-            .build(m_OffScreenSets[i]);
-        naDescriptorWriter{*m_RenderResource->getOneImageSetLayout(), *m_RenderResource->getDescriptorPool()}
-            .writeImage(0, &shadowMapInfo)
-            .build(m_ShadowMapSets[i]);
+void RenderManager::createDescriptorSets(uint32_t frame_index) {
+    // written every frame from the transient pool, so they also follow the attachments when the swapchain is recreated
+    naSampler sampler{*m_Device, SamplerType::Linear};
+    naDescriptorInfo offscreenInfo{.image = sampler.descriptorInfo(m_Renderer->getFrameBuffer().getGroup(frame_index).images[2])};
+    naDescriptorInfo shadowMapInfo{.image = sampler.descriptorInfo(m_Renderer->getFrameBuffer().getGroup(frame_index).images[3])};
+
+    auto& layout = *m_RenderResource->getOneImageSetLayout();
+    auto& allocator = *m_RenderResource->getTransientDescriptorAllocator();
+    if (!allocator.allocate(layout.get(), m_OffScreenSets[frame_index]) ||
+        !allocator.allocate(layout.get(), m_ShadowMapSets[frame_index])) {
+        throw std::runtime_error("failed to allocate frame descriptor sets!");
     }
+    layout.update(m_OffScreenSets[frame_index], &offscreenInfo);
+    layout.update(m_ShadowMapSets[frame_index], &shadowMapInfo);
 }
 
 
 void RenderManager::tick(const Scene& scene) {
+    NARY_PROFILE_SCOPE("RenderManager::tick");
+
+    // submit the uploads recorded since last frame, they are ordered before this frame on the graphics queue
+    m_Device->uploader().flush();
+
     if (auto commandBuffer = m_Renderer->beginFrame()) {
         auto frame_index =  m_Renderer->getFrameIndex();
         m_RenderResource->setCurrentFrameIndex(frame_index);
+        createDescriptorSets(frame_index);
+
+        // the frame's fence was waited on, resources released by finished frames are destroyed
+        m_Device->beginFrame();
+
+        // nothing of this frame is recorded yet, so changed pipelines can be swapped in here
+        if (m_ShaderHotReload)
+            m_ShaderHotReload->update();
 
         m_RenderScene->Update(scene, *m_RenderResource);
+        m_RenderSystem->preparePipelines(*m_RenderScene);
+
+        m_Recorder->beginFrame(frame_index);
+        m_GpuProfiler->beginFrame(commandBuffer, frame_index);
+
+        {
+            GpuZone frameZone{*m_GpuProfiler, commandBuffer, "Frame"};
+
+            // timestamps may not be written by the primary inside a subpass of secondary command buffers,
+            // so the first chunk writes the begin and the last chunk writes the end of the zone
+            auto recordZone = [&](const char* name, const VkCommandBufferInheritanceInfo& inheritance,
+                                  size_t count, size_t minChunkSize, const naParallelRecorder::RecordFn& fn) {
+                auto zone = m_GpuProfiler->allocateZone(name);
+                m_Recorder->record(commandBuffer, inheritance, count, minChunkSize,
+                                   [&](VkCommandBuffer cmd, size_t begin, size_t end) {
+                    if (begin == 0) m_GpuProfiler->writeBegin(cmd, zone);
+                    fn(cmd, begin, end);
+                    if (end == count) m_GpuProfiler->writeEnd(cmd, zone);
+                });
+            };
+
+            m_Renderer->beginRenderPass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            recordZone("Shadow",
+                       m_Renderer->getInheritanceInfo(0),
+                       naShadowSystem::getShadowCasterCount(*m_RenderScene),
+                       MIN_DRAWS_PER_SECONDARY,
+                       [&](VkCommandBuffer cmd, size_t begin, size_t end) {
+                m_Renderer->setViewport(cmd);
+                m_ShadowSystem->renderGameObjects(*m_RenderScene, cmd, begin, end);
+            });
+
+            m_Renderer->nextSubpass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            auto forwardInheritance = m_Renderer->getInheritanceInfo(1);
+            recordZone("Forward",
+                       forwardInheritance,
+                       m_RenderScene->m_VisableEntities.size(),
+                       MIN_DRAWS_PER_SECONDARY,
+                       [&](VkCommandBuffer cmd, size_t begin, size_t end) {
+                m_Renderer->setViewport(cmd);
+                m_RenderSystem->renderGameObjects(*m_RenderScene, cmd, m_ShadowMapSets[frame_index], begin, end);
+            });
+            // the whole subpass uses secondary command buffers, so do the lights
+            recordZone("Point lights", forwardInheritance, 1, 1, [&](VkCommandBuffer cmd, size_t, size_t) {
+                m_Renderer->setViewport(cmd);
+                m_PointLightSystem->render(*m_RenderScene, cmd);
+            });
+            m_Renderer->endRenderPass();
 
-        m_Renderer->beginRenderPass();
-        m_ShadowSystem->renderGameObjects(*m_RenderScene, commandBuffer);
-        m_Renderer->nextSubpass();
-        m_RenderSystem->renderGameObjects(*m_RenderScene, commandBuffer, m_ShadowMapSets[frame_index]);
-        m_PointLightSystem->render(*m_RenderScene, commandBuffer);
-        m_Renderer->endRenderPass();
 
+            m_Renderer->beginSwapChainRenderPass();
+            {
+                GpuZone zone{*m_GpuProfiler, commandBuffer, "FXAA"};
+                m_PostProcessing->render(m_OffScreenSets[frame_index], commandBuffer, 6, 1);
+            }
+            {
+                GpuZone zone{*m_GpuProfiler, commandBuffer, "UI"};
+                DrawUI(commandBuffer);
+            }
+            m_Renderer->endSwapChainRenderPass();
+        }
 
-        m_Renderer->beginSwapChainRenderPass();
-        m_PostProcessing->render(m_OffScreenSets[frame_index], commandBuffer, 6, 1);
-        
-        DrawUI(commandBuffer);
-        
-        m_Renderer->endSwapChainRenderPass();
         m_Renderer->endFrame();
     }
 }
 
 void RenderManager::DrawUI(VkCommandBuffer cmdbuf) {
+    if (!m_UI) return;
+
 //    static char text[21*14]{};
 //    static mathpls::vec4 a{3.f, 2.f, 2.95f, 2.03f};
 //    constexpr float G = 514;
@@ -105,17 +232,29 @@ void RenderManager::DrawUI(VkCommandBuffer cmdbuf) {
     ImGui::Image(&m_ShadowMapSets[m_Renderer->getFrameIndex()], {320, 200});
 
     ImGui::End();
+
+    m_UI->drawGpuProfiler(*m_GpuProfiler);
+    m_UI->drawCpuProfiler();
+    m_UI->drawMemoryStats();
     
     m_UI->endFrame(cmdbuf);
     m_UI->beginFrame(); // so that it can be used externally
 }
 
 naWin* RenderManager::getWindow() const {
-    return &m_Window;
+    return m_Window;
+}
+
+naRenderer* RenderManager::getRenderer() const {
+    return m_Renderer.get();
 }
 
 RenderResource* RenderManager::getRenderResource() const {
     return m_RenderResource.get();
 }
 
+naGpuProfiler* RenderManager::getGpuProfiler() const {
+    return m_GpuProfiler.get();
+}
+
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "naRenderer.hpp"
+#include "naParallelRecorder.hpp"
+#include "naGpuProfiler.hpp"
+#include "naThreadPool.hpp"
 #include "RenderResource.hpp"
 #include "RenderScene.hpp"
 
@@ -8,6 +11,7 @@
 #include "naPointLightSystem.hpp"
 #include "naShadowSystem.hpp"
 #include "naRenderShaderOnly.hpp"
+#include "naShaderHotReload.hpp"
 
 #include "naUISystem.hpp"
 
@@ -16,6 +20,10 @@ namespace nary {
 class RenderManager {
 public:
     RenderManager(naWin& window);
+    /**
+     * headless, renders into offscreen images of the given extent, no UI
+     */
+    RenderManager(VkExtent2D extent);
     ~RenderManager();
 
     RenderManager(const RenderManager&) = delete;
@@ -24,14 +32,20 @@ public:
     void tick(const Scene& scene);
 
     naWin* getWindow() const;
+    naRenderer* getRenderer() const;
     RenderResource* getRenderResource() const;
+    naGpuProfiler* getGpuProfiler() const;
     
 private:
-    naWin& m_Window;
+    naWin* m_Window = nullptr;
 
     std::unique_ptr<naDevice> m_Device;
     std::unique_ptr<naRenderer> m_Renderer;
 
+    std::unique_ptr<naThreadPool> m_ThreadPool;
+    std::unique_ptr<naParallelRecorder> m_Recorder;
+    std::unique_ptr<naGpuProfiler> m_GpuProfiler;
+
     std::unique_ptr<RenderResource> m_RenderResource;
     std::unique_ptr<RenderScene> m_RenderScene;
 
@@ -40,13 +54,15 @@ private:
     std::unique_ptr<naShadowSystem> m_ShadowSystem;
     std::unique_ptr<naRenderShaderOnly> m_PostProcessing;
 
+    std::unique_ptr<naShaderHotReload> m_ShaderHotReload;
+
     std::unique_ptr<naUISystem> m_UI;
 
     std::vector<VkDescriptorSet> m_OffScreenSets{naSwapChain::MAX_FRAMES_IN_FLIGHT};
     std::vector<VkDescriptorSet> m_ShadowMapSets{naSwapChain::MAX_FRAMES_IN_FLIGHT};
 
-    void initialize();
-    void createDescriptorSets();
+    void initialize(VkExtent2D extent = {});
+    void createDescriptorSets(uint32_t frame_index);
 
     void DrawUI(VkCommandBuffer cmdbuf);
 
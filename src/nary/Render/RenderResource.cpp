@@ -1,56 +1,110 @@
 #include "RenderResource.hpp"
+#include "naLayoutCache.hpp"
 
+#include "se_tools.h"
+
+#include <bit>
 #include <cassert>
+#include <stdexcept>
+#include <utility>
 
 namespace nary {
 
 RenderResource::RenderResource(naDevice& device) : p_Device(&device) {
-    createDescriptorPool();
+    createDescriptorAllocators();
     createSetLayouts();
-    createGlobalUniformBuffer();
+    if (p_Device->supportsBindless())
+        createBindlessTextureSet();
+    createGlobalUniformBuffers();
+    createMaterialBuffers();
     createDefaulrTexture();
     createDefaultMaterial();
+    createDefaultMesh();
 }
 
-void RenderResource::createDescriptorPool() {
-    m_DescriptorPool = naDescriptorPool::Builder(*p_Device)
-        .setMaxSets(1000)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 100)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 100)
-        .build();
+RenderResource::RenderResource() {
+    m_Textures[0] = nullptr;
+    createDefaultMaterial();
+    createDefaultMesh();
+}
+
+void RenderResource::createDescriptorAllocators() {
+    m_DescriptorAllocator = std::make_unique<naDescriptorAllocator>(*p_Device);
+    for (auto& i : m_TransientDescriptorAllocators)
+        i = std::make_unique<naDescriptorAllocator>(*p_Device, 16);
 }
 
 void RenderResource::createSetLayouts() {
-    m_OneImageSetLayout = naDescriptorSetLayout::Builder(*p_Device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS)
-        .build();
-    m_GlobalUboSetLayout = naDescriptorSetLayout::Builder(*p_Device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-        .build();
-    m_MaterialSetLayout = naDescriptorSetLayout::Builder(*p_Device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS)
+    // every shader uses the same set indices, the bindings and their stages come from the registered shaders
+    auto& layoutCache = p_Device->layoutCache();
+    m_GlobalUboSetLayout = layoutCache.getSetLayout(0);
+    m_OneImageSetLayout = layoutCache.getSetLayout(1);
+    m_MaterialSetLayout = layoutCache.getSetLayout(2);
+}
+
+void RenderResource::createBindlessTextureSet() {
+    assert(m_MaterialSetLayout->isUpdateAfterBind() && "the shaders were compiled without BINDLESS");
+    // one set for the whole run, its textures are written while frames using it are in flight
+    m_BindlessPool = naDescriptorPool::Builder{*p_Device}
+        .setMaxSets(1)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, p_Device->maxBindlessDescriptors())
+        .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT)
         .build();
+    if (!m_BindlessPool->allocateDescriptor(m_MaterialSetLayout->get(), m_BindlessTextureSet))
+        throw std::runtime_error("failed to allocate bindless texture set!");
 }
 
-void RenderResource::createGlobalUniformBuffer() {
-    m_GlobalUniformBuffer =
-        std::make_unique<naBuffer>(*p_Device, sizeof(GlobalUbo), 1,VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    m_GlobalUniformBuffer->map();
+void RenderResource::createGlobalUniformBuffers() {
+    // one per frame in flight, written while the previous frame still reads its own
+    for (auto& buffer : m_GlobalUniformBuffers) {
+        buffer = std::make_unique<naBuffer>(*p_Device, sizeof(GlobalUbo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        buffer->map();
+    }
+}
 
-    auto bufferInfo = m_GlobalUniformBuffer->descriptorInfo();
-    naDescriptorWriter{*m_GlobalUboSetLayout, *m_DescriptorPool}
-        .writeBuffer(0, &bufferInfo)
-        .build(m_GlobalUboDescriptorSet);
+void RenderResource::createMaterialBuffers() {
+    LOOP (naSwapChain::MAX_FRAMES_IN_FLIGHT) {
+        if (!m_DescriptorAllocator->allocate(m_GlobalUboSetLayout->get(), m_GlobalDescriptorSets[i]))
+            throw std::runtime_error("failed to allocate global descriptor set!");
+        createMaterialBuffer(i, MIN_MATERIAL_CAPACITY);
+    }
+}
+
+void RenderResource::createMaterialBuffer(uint32_t frame_index, size_t capacity) {
+    // coherent, the frame reads what was written before its submit without a flush
+    auto& buffer = m_FrameMaterials[frame_index].buffer;
+    buffer = std::make_unique<naBuffer>(*p_Device, sizeof(MaterialParams), static_cast<uint32_t>(capacity),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    buffer->map();
+    if (!m_MaterialParams.empty())
+        buffer->writeToBuffer(m_MaterialParams.data(), m_MaterialParams.size() * sizeof(MaterialParams));
+
+    // set 0 in binding order: global ubo, material params
+    naDescriptorInfo data[2]{};
+    data[0].buffer = m_GlobalUniformBuffers[frame_index]->descriptorInfo();
+    data[1].buffer = buffer->descriptorInfo();
+    m_GlobalUboSetLayout->update(m_GlobalDescriptorSets[frame_index], data);
+}
+
+void RenderResource::flushMaterials(uint32_t frame_index) {
+    auto& frame = m_FrameMaterials[frame_index];
+    if (frame.buffer->getInstanceCount() < m_MaterialParams.size()) {
+        // the frame's fence was waited for, so its buffer and global set can be replaced
+        createMaterialBuffer(frame_index, std::bit_ceil(m_MaterialParams.size()));
+    } else {
+        for (auto id : frame.dirty)
+            frame.buffer->writeToIndex(&m_MaterialParams[id], static_cast<int>(id));
+    }
+    frame.dirty.clear();
 }
 
 void RenderResource::createDefaultMaterial() {
     Material default_material{};
     default_material.baseColorFactor = {1.f};
     m_Materials[0] = default_material;
-    createMaterialUniformBuffers(0);
-    updateMaterialDescriptorSet(0);
+    updateMaterial(0);
 }
 
 void RenderResource::createDefaulrTexture() {
@@ -60,30 +114,134 @@ void RenderResource::createDefaulrTexture() {
     info.height = 1;
     uint8_t data[4]{0, 0, 0, 0}; // default to a transparent all black image
     m_Textures[0] = std::make_unique<naImage>(naImage::createWithImageData(*p_Device, data, info));
+    if (isBindless()) writeBindlessTexture(0);
 }
 
-void RenderResource::createMaterialUniformBuffers(UID id) {
-    auto& buffer = m_MaterialUniformBuffers[id];
-    buffer = std::make_unique<naBuffer>(*p_Device, 6*sizeof(float), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+void RenderResource::createDefaultMesh() {
+    // a unit cube, drawn in place of the meshes that are still loading
+    naModel::Builder builder;
+    const mathpls::vec3 normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    for (auto& n : normals) {
+        // two axes spanning the face
+        mathpls::vec3 u = n.x != 0 ? mathpls::vec3{0, 1, 0} : mathpls::vec3{1, 0, 0};
+        mathpls::vec3 v = mathpls::cross(n, u);
+
+        auto base = static_cast<uint32_t>(builder.vertices.size());
+        const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+        for (auto& c : corners) {
+            naModel::Vertex vertex{};
+            vertex.position = (n + u * c[0] + v * c[1]) * .5f;
+            vertex.normal = n;
+            vertex.uv = {c[0] * .5f + .5f, c[1] * .5f + .5f};
+            builder.vertices.push_back(vertex);
+        }
+        for (uint32_t i : {0u, 1u, 2u, 2u, 3u, 0u})
+            builder.indices.push_back(base + i);
+    }
+    m_Models[0] = isNull() ? std::make_unique<naModel>(builder) : std::make_unique<naModel>(*p_Device, builder);
 }
 
 naDevice* RenderResource::getDevice() const {
     return p_Device;
 }
 
-UID RenderResource::addMaterial(const Material& m) {
+AssetRef RenderResource::addMaterial(const Material& m) {
     auto id = m_Materials.insert(m);
-    createMaterialUniformBuffers(id);
-    updateMaterialDescriptorSet(id);
-    return id;
+    updateMaterial(id);
+    return {m_MaterialRefs, id};
+}
+
+AssetRef RenderResource::addMesh(std::unique_ptr<naModel>&& m) {
+    if (m) m_AssetMemory += m->getMemorySize();
+    return {m_MeshRefs, m_Models.insert(std::move(m))};
+}
+
+AssetRef RenderResource::addTexture(std::unique_ptr<naImage>&& t) {
+    if (t) m_AssetMemory += t->getMemorySize();
+    auto id = m_Textures.insert(std::move(t));
+    if (isBindless() && m_Textures[id]) writeBindlessTexture(id);
+    return {m_TextureRefs, id};
+}
+
+AssetRef RenderResource::reserveMesh() {
+    return {m_MeshRefs, m_Models.insert(nullptr)};
+}
+
+AssetRef RenderResource::reserveTexture() {
+    return {m_TextureRefs, m_Textures.insert(nullptr)};
+}
+
+void RenderResource::setMesh(UID id, std::unique_ptr<naModel>&& m) {
+    if (m) m_AssetMemory += m->getMemorySize();
+    std::swap(m_Models[id], m);
+    if (m) m_AssetMemory -= m->getMemorySize();
+    destroyLater(std::move(m));
 }
 
-UID RenderResource::addMesh(std::unique_ptr<naModel>&& m) {
-    return m_Models.insert(std::move(m));
+void RenderResource::setTexture(UID id, std::unique_ptr<naImage>&& t) {
+    if (t) m_AssetMemory += t->getMemorySize();
+    std::swap(m_Textures[id], t);
+    if (t) m_AssetMemory -= t->getMemorySize();
+    destroyLater(std::move(t));
+    m_TextureImageInfos.erase(id);
+    // materials sampled the default texture until now
+    if (isBindless()) {
+        // the slot was unused, the materials' params switch to it as each frame begins
+        writeBindlessTexture(id);
+        std::vector<UID> users;
+        for (auto& [material_id, material] : m_Materials)
+            if (material.base_color_texture == id)
+                users.push_back(material_id);
+        updateMaterials(users);
+    } else if (auto it = m_TextureDescriptorSets.find(id); it != m_TextureDescriptorSets.end()) {
+        // frames in flight may have the old set bound, it isn't update after bind, so it's replaced instead
+        VkDescriptorSet set;
+        if (!m_DescriptorAllocator->allocate(m_MaterialSetLayout->get(), set))
+            throw std::runtime_error("failed to allocate material descriptor set!");
+        naDescriptorInfo data{.image = getTextureImageInfo(id)};
+        m_MaterialSetLayout->update(set, &data);
+
+        p_Device->deferDestroy([this, old = std::exchange(it->second, set)] {
+            m_DescriptorAllocator->free(m_MaterialSetLayout->get(), old);
+        });
+    }
 }
 
-UID RenderResource::addTexture(std::unique_ptr<naImage>&& t) {
-    return m_Textures.insert(std::move(t));
+void RenderResource::removeMaterial(UID id) {
+    // frames in flight read their own copy of its params, the entry is rewritten when the id is reused.
+    // Its texture references are dropped with it
+    m_Materials.erase(id);
+}
+
+void RenderResource::removeMesh(UID id) {
+    auto& mesh = m_Models[id];
+    if (mesh) m_AssetMemory -= mesh->getMemorySize();
+    destroyLater(std::move(mesh));
+    m_Models.erase(id);
+}
+
+void RenderResource::removeTexture(UID id) {
+    auto& texture = m_Textures[id];
+    if (texture) m_AssetMemory -= texture->getMemorySize();
+    destroyLater(std::move(texture));
+    m_TextureImageInfos.erase(id);
+    if (isNull()) {
+        m_Textures.erase(id);
+        return;
+    }
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (auto it = m_TextureDescriptorSets.find(id); it != m_TextureDescriptorSets.end()) {
+        set = it->second;
+        m_TextureDescriptorSets.erase(it);
+    }
+    // frames in flight may still sample its bindless slot or its set, so the id (the slot) is only handed out again
+    // once they are done. The queue is drained before the render resource is destroyed
+    p_Device->deferDestroy([this, id, set] {
+        m_Textures.erase(id);
+        if (set != VK_NULL_HANDLE)
+            m_DescriptorAllocator->free(m_MaterialSetLayout->get(), set);
+    });
 }
 
 UidMap<Material>& RenderResource::getMaterials() {
@@ -95,71 +253,125 @@ Material* RenderResource::getMaterial(UID id) const {
 }
 
 naModel* RenderResource::getMesh(UID id) const {
-    return m_Models[id].get();
+    auto& mesh = m_Models[id];
+    return mesh ? mesh.get() : m_Models[0].get();
 }
 
 naImage* RenderResource::getTexture(UID id) const {
-    return m_Textures[id].get();
+    auto& texture = m_Textures[id];
+    return texture ? texture.get() : m_Textures[0].get();
 }
 
-naDescriptorPool* RenderResource::getDescriptorPool() const {
-    return m_DescriptorPool.get();
+naDescriptorAllocator* RenderResource::getDescriptorAllocator() const {
+    return m_DescriptorAllocator.get();
+}
+
+naDescriptorAllocator* RenderResource::getTransientDescriptorAllocator() const {
+    return m_TransientDescriptorAllocators[curr_frame_index].get();
+}
+
+naFrameAllocator* RenderResource::getFrameAllocator() const {
+    if (isNull()) return nullptr;
+    // created on first use, renderers that don't need scratch memory don't pay for its buffer
+    if (!m_FrameAllocator) {
+        m_FrameAllocator = std::make_unique<naFrameAllocator>(*p_Device, FRAME_ALLOCATOR_SIZE);
+        m_FrameAllocator->beginFrame(curr_frame_index);
+    }
+    return m_FrameAllocator.get();
 }
 
 naDescriptorSetLayout* RenderResource::getOneImageSetLayout() const {
-    return m_OneImageSetLayout.get();
+    return m_OneImageSetLayout;
 }
 
 naDescriptorSetLayout* RenderResource::getGlbalUboSetLayout() const {
-    return m_GlobalUboSetLayout.get();
+    return m_GlobalUboSetLayout;
 }
 
 naDescriptorSetLayout* RenderResource::getMaterialSetLayout() const {
-    return m_MaterialSetLayout.get();
+    return m_MaterialSetLayout;
 }
 
 void RenderResource::updateGlobalUbo(const GlobalUbo& ubo) const {
-    m_GlobalUniformBuffer->writeToBuffer((void*)&ubo);
-    m_GlobalUniformBuffer->flush();
+    if (isNull()) return;
+    // coherent, no flush needed
+    m_GlobalUniformBuffers[curr_frame_index]->writeToBuffer((void*)&ubo);
 }
 
 VkDescriptorSet RenderResource::getGlobalUboDescriptorSet() const {
-    return m_GlobalUboDescriptorSet;
+    return m_GlobalDescriptorSets[curr_frame_index];
 }
 
-void RenderResource::updateMaterialDescriptorSet(UID material_id) {
-    assert(m_Materials.contains(material_id));
-
-    auto& mat = m_Materials[material_id];
-    auto& set = m_MaterialDescriptorSets[material_id];
-
-    auto& uboBuffer = *m_MaterialUniformBuffers[material_id];
-    uboBuffer.map();
-    uboBuffer.writeToBuffer(&mat.baseColorFactor);
-    uboBuffer.unmap();
+void RenderResource::updateMaterial(UID material_id) {
+    updateMaterials({material_id});
+}
 
-    auto bufferInfo = uboBuffer.descriptorInfo();
+void RenderResource::updateMaterials(const std::vector<UID>& material_ids) {
+    for (auto id : material_ids) {
+        assert(m_Materials.contains(id));
+        auto& mat = m_Materials[id];
+
+        if (m_MaterialParams.size() <= id)
+            m_MaterialParams.resize(id + 1);
+        auto& params = m_MaterialParams[id];
+        params.baseColor = mat.baseColorFactor;
+        params.metallic = mat.metallicFactor;
+        params.roughness = mat.roughnessFactor;
+        params.baseColorTexture = getTextureSlot(mat.base_color_texture);
+
+        if (isNull()) continue;
+        // frames in flight keep reading their own copy, each frame picks the change up when it begins
+        for (auto& frame : m_FrameMaterials)
+            frame.dirty.push_back(id);
+
+        if (isBindless()) continue;
+        auto [it, inserted] = m_TextureDescriptorSets.try_emplace(mat.base_color_texture);
+        if (inserted) {
+            if (!m_DescriptorAllocator->allocate(m_MaterialSetLayout->get(), it->second))
+                throw std::runtime_error("failed to allocate material descriptor set!");
+            naDescriptorInfo data{.image = getTextureImageInfo(mat.base_color_texture)};
+            m_MaterialSetLayout->update(it->second, &data);
+        }
+    }
+}
 
-    naDescriptorWriter writer{*m_MaterialSetLayout, *m_DescriptorPool};
-    writer.writeBuffer(0, &bufferInfo);
+const VkDescriptorImageInfo& RenderResource::getTextureImageInfo(UID id) {
+    auto [it, inserted] = m_TextureImageInfos.try_emplace(id);
+    if (inserted) {
+        auto& texture = *getTexture(id);
+        it->second = naSampler{*p_Device, SamplerType::Mipmap, texture.getInfo().mipLevels}.descriptorInfo(texture);
+    }
+    return it->second;
+}
 
-    auto& base_color_texture = *m_Textures[mat.base_color_texture];
-    naSampler sampler{*p_Device, SamplerType::Mipmap, base_color_texture.getInfo().mipLevels};
-    auto imageInfo = sampler.descriptorInfo(base_color_texture);
-    writer.writeImage(1, &imageInfo);
+void RenderResource::writeBindlessTexture(UID id) {
+    if (id >= p_Device->maxBindlessDescriptors()) {
+        WARNING_LOG("texture {} exceeds the {} bindless slots, materials sample the default texture", id, p_Device->maxBindlessDescriptors());
+        return;
+    }
+    naDescriptorInfo info{.image = getTextureImageInfo(id)};
+    m_MaterialSetLayout->updateElement(m_BindlessTextureSet, 0, static_cast<uint32_t>(id), info);
+}
 
-    if (set == VK_NULL_HANDLE)
-        writer.build(set);
-    else
-        writer.overwrite(set);
+uint32_t RenderResource::getTextureSlot(UID id) {
+    // textures that are still loading have no slot yet
+    if (!isBindless() || id >= p_Device->maxBindlessDescriptors() || !m_Textures.contains(id) || !m_Textures[id])
+        return 0;
+    return static_cast<uint32_t>(id);
 }
 
 VkDescriptorSet RenderResource::getMaterialDescriptorSet(UID material_id) const {
-    return m_MaterialDescriptorSets.at(material_id);
+    if (isBindless()) return m_BindlessTextureSet;
+    return m_TextureDescriptorSets.at(m_Materials[material_id].base_color_texture);
 }
 
 void RenderResource::setCurrentFrameIndex(uint32_t current_index) {
     curr_frame_index = current_index;
+    if (isNull()) return;
+    // the frame's fence was waited for, nothing uses its transient sets, scratch memory or material buffer anymore
+    m_TransientDescriptorAllocators[curr_frame_index]->reset();
+    if (m_FrameAllocator) m_FrameAllocator->beginFrame(curr_frame_index);
+    flushMaterials(curr_frame_index);
 }
 
 uint32_t RenderResource::getCurrentFrameIndex() const {
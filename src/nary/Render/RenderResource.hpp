@@ -5,8 +5,11 @@
 #include "naCamera.hpp"
 #include "naModel.hpp"
 #include "naDescriptors.hpp"
+#include "naFrameAllocator.hpp"
+#include "naSwapChain.hpp"
 #include "ResourceManager.hpp"
 
+#include <array>
 #include <vector>
 #include <unordered_map>
 #include <memory>
@@ -29,11 +32,23 @@ struct Material {
     bool is_blend = 0;
     bool is_double_side = 0;
 
-    UID base_color_texture = 0;
-    UID metallic_roughness_texture = 0;
-    UID normal_texture = 0;
-    UID occlusion_texture_image = 0;
-    UID emissive_texture = 0;
+    // a material keeps its textures loaded
+    AssetRef base_color_texture;
+    AssetRef metallic_roughness_texture;
+    AssetRef normal_texture;
+    AssetRef occlusion_texture_image;
+    AssetRef emissive_texture;
+};
+
+/**
+ * the std430 layout of a material in the material storage buffer, indexed by the material's id
+ */
+struct MaterialParams {
+    mathpls::vec4 baseColor;
+    float metallic;
+    float roughness;
+    uint32_t baseColorTexture; // slot in the bindless texture array, 0 is the default texture
+    float _padding;
 };
 
 struct PointLight {
@@ -101,64 +116,166 @@ struct RenderEntity {
 
 class RenderResource {
 public:
+    /**
+     * the set layouts come from the device's layout cache, register the shaders that use them first
+     */
     RenderResource(naDevice& device);
+    /**
+     * null backend, keeps the material table and mesh metadata but creates no GPU objects
+     */
+    RenderResource();
 
     RenderResource(const RenderResource&) = delete;
     RenderResource& operator=(const RenderResource&) = delete;
 
     naDevice* getDevice() const;
-
-    UID addMaterial(const Material& m);
-    UID addMesh(std::unique_ptr<naModel>&& m);
-    UID addTexture(std::unique_ptr<naImage>&& t);
+    bool isNull() const {return p_Device == nullptr;}
+    /**
+     * all textures are in one array in set 2, indexed by the material, if the device supports descriptor indexing
+     */
+    bool isBindless() const {return m_BindlessTextureSet != VK_NULL_HANDLE;}
+
+    /**
+     * the ids are reference counted, the asset manager unloads what nothing refers to anymore.
+     * The default assets (id 0) aren't counted and never unloaded
+     */
+    AssetRef addMaterial(const Material& m);
+    AssetRef addMesh(std::unique_ptr<naModel>&& m);
+    AssetRef addTexture(std::unique_ptr<naImage>&& t);
+
+    /**
+     * reserve an id for an asset that is still loading, getMesh()/getTexture() return the default one until it's set
+     */
+    AssetRef reserveMesh();
+    AssetRef reserveTexture();
+    /**
+     * another reference to a loaded asset
+     */
+    AssetRef refMesh(UID id) {return {m_MeshRefs, id};}
+    AssetRef refTexture(UID id) {return {m_TextureRefs, id};}
+    RefCounts& getMaterialRefCounts() {return *m_MaterialRefs;}
+    RefCounts& getMeshRefCounts() {return *m_MeshRefs;}
+    RefCounts& getTextureRefCounts() {return *m_TextureRefs;}
+    /**
+     * a replaced asset is destroyed once the frames in flight are done with it
+     */
+    void setMesh(UID id, std::unique_ptr<naModel>&& m);
+    void setTexture(UID id, std::unique_ptr<naImage>&& t);
+    /**
+     * unload an asset nothing refers to, it is destroyed once the frames in flight are done with it
+     * and its id is handed out again
+     */
+    void removeMaterial(UID id);
+    void removeMesh(UID id);
+    void removeTexture(UID id);
+    /**
+     * GPU memory of the meshes and textures, the default ones aside
+     */
+    VkDeviceSize getAssetMemory() const {return m_AssetMemory;}
 
     UidMap<Material>& getMaterials();
     Material* getMaterial(UID id) const;
     naModel* getMesh(UID id) const;
     naImage* getTexture(UID id) const;
 
-    naDescriptorPool* getDescriptorPool() const;
+    naDescriptorAllocator* getDescriptorAllocator() const;
+    /**
+     * for sets that live one frame, the current frame's pools are reset by setCurrentFrameIndex()
+     */
+    naDescriptorAllocator* getTransientDescriptorAllocator() const;
+    /**
+     * per frame GPU scratch memory, the current frame's region is reset by setCurrentFrameIndex(), null for the null backend.
+     * created on the first call, not thread safe, like naFrameAllocator::allocate()
+     */
+    naFrameAllocator* getFrameAllocator() const;
     naDescriptorSetLayout* getOneImageSetLayout() const;
     naDescriptorSetLayout* getGlbalUboSetLayout() const;
     naDescriptorSetLayout* getMaterialSetLayout() const;
 
+    /**
+     * writes the current frame's copy, call after setCurrentFrameIndex()
+     */
     void updateGlobalUbo(const GlobalUbo& ubo) const;
+    /**
+     * the current frame's set 0, the global ubo and the material storage buffer
+     */
     VkDescriptorSet getGlobalUboDescriptorSet() const;
 
-    void updateMaterialDescriptorSet(UID material_id);
+    /**
+     * call after changing a material, every frame in flight uploads it when it begins
+     */
+    void updateMaterial(UID material_id);
+    void updateMaterials(const std::vector<UID>& material_ids);
+    /**
+     * set 2, the material's textures. Materials with the same textures share it, all share it if bindless
+     */
     VkDescriptorSet getMaterialDescriptorSet(UID material_id) const;
 
     void setCurrentFrameIndex(uint32_t current_index);
     uint32_t getCurrentFrameIndex() const;
 
 private:
-    naDevice* p_Device;
-
-    std::unique_ptr<naDescriptorPool> m_DescriptorPool;
-
-    std::unique_ptr<naDescriptorSetLayout> m_OneImageSetLayout; // use for offscreen, shadowmap
-    std::unique_ptr<naDescriptorSetLayout> m_GlobalUboSetLayout;
-    std::unique_ptr<naDescriptorSetLayout> m_MaterialSetLayout;
-
-    std::unique_ptr<naBuffer> m_GlobalUniformBuffer;
-    VkDescriptorSet m_GlobalUboDescriptorSet;
+    template <class T>
+    void destroyLater(std::unique_ptr<T>&& resource) {
+        if (!resource || isNull()) return;
+        std::shared_ptr<T> shared = std::move(resource); // std::function needs a copyable deleter
+        p_Device->deferDestroy([shared]() mutable { shared.reset(); });
+    }
 
-    std::unordered_map<UID, std::unique_ptr<naBuffer>> m_MaterialUniformBuffers;
-    std::unordered_map<UID, VkDescriptorSet> m_MaterialDescriptorSets;
+    naDevice* p_Device = nullptr;
+
+    std::unique_ptr<naDescriptorAllocator> m_DescriptorAllocator;
+    std::array<std::unique_ptr<naDescriptorAllocator>, naSwapChain::MAX_FRAMES_IN_FLIGHT> m_TransientDescriptorAllocators;
+    mutable std::unique_ptr<naFrameAllocator> m_FrameAllocator; // created by the first getFrameAllocator()
+
+    // owned by the device's layout cache
+    naDescriptorSetLayout* m_OneImageSetLayout = nullptr; // set 1, use for offscreen, shadowmap
+    naDescriptorSetLayout* m_GlobalUboSetLayout = nullptr; // set 0
+    naDescriptorSetLayout* m_MaterialSetLayout = nullptr; // set 2
+
+    std::array<std::unique_ptr<naBuffer>, naSwapChain::MAX_FRAMES_IN_FLIGHT> m_GlobalUniformBuffers; // persistently mapped
+    std::array<VkDescriptorSet, naSwapChain::MAX_FRAMES_IN_FLIGHT> m_GlobalDescriptorSets{};
+
+    // each frame in flight reads its own copy, so one can be written while the other is drawn
+    struct FrameMaterials {
+        std::unique_ptr<naBuffer> buffer; // persistently mapped
+        std::vector<UID> dirty;
+    };
+    static constexpr size_t MIN_MATERIAL_CAPACITY = 64;
+    static constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE = 4 * 1024 * 1024;
+    std::vector<MaterialParams> m_MaterialParams; // indexed by material id
+    std::array<FrameMaterials, naSwapChain::MAX_FRAMES_IN_FLIGHT> m_FrameMaterials;
+
+    std::unordered_map<UID, VkDescriptorSet> m_TextureDescriptorSets; // by base color texture
+    // bindless, the slot of a texture is its id
+    std::unique_ptr<naDescriptorPool> m_BindlessPool;
+    VkDescriptorSet m_BindlessTextureSet = VK_NULL_HANDLE;
+    std::unordered_map<UID, VkDescriptorImageInfo> m_TextureImageInfos; // with their mipmap sampler, dropped when the texture is set
     
     UidMap<Material> m_Materials;
     UidMap<std::unique_ptr<naModel>> m_Models;
     UidMap<std::unique_ptr<naImage>> m_Textures;
+    std::shared_ptr<RefCounts> m_MaterialRefs = std::make_shared<RefCounts>();
+    std::shared_ptr<RefCounts> m_MeshRefs = std::make_shared<RefCounts>();
+    std::shared_ptr<RefCounts> m_TextureRefs = std::make_shared<RefCounts>();
+    VkDeviceSize m_AssetMemory = 0;
 
-    uint32_t curr_frame_index;
+    uint32_t curr_frame_index = 0;
 
-    void createDescriptorPool();
+    void createDescriptorAllocators();
     void createSetLayouts();
-    void createGlobalUniformBuffer();
+    void createGlobalUniformBuffers();
+    void createMaterialBuffers();
+    void createBindlessTextureSet();
     void createDefaultMaterial();
     void createDefaulrTexture();
+    void createDefaultMesh();
 
-    void createMaterialUniformBuffers(UID id);
+    void createMaterialBuffer(uint32_t frame_index, size_t capacity);
+    void flushMaterials(uint32_t frame_index);
+    const VkDescriptorImageInfo& getTextureImageInfo(UID id);
+    void writeBindlessTexture(UID id);
+    uint32_t getTextureSlot(UID id);
 
 };
 
@@ -1,6 +1,7 @@
 #define MATHPLS_DEPTH_0_1
 #include "RenderScene.hpp"
 #include "RenderUtil.hpp"
+#include "naProfiler.hpp"
 
 #include "se_tools.h"
 
@@ -18,14 +19,30 @@ void RenderScene::clear() {
 }
 
 void RenderScene::Update(const Scene& scene, const RenderResource& resource) {
-    clear();
+    NARY_PROFILE_SCOPE("RenderScene::Update");
 
-    pickUpEntities(scene, resource);
-    filterCameraVisable();
-    filterPointLightVisable();
-    processDirectionalLight();
+    clear();
 
-    updateGlobalUbo(resource);
+    {
+        NARY_PROFILE_SCOPE("RenderScene::pickUpEntities");
+        pickUpEntities(scene, resource);
+    }
+    {
+        NARY_PROFILE_SCOPE("RenderScene::filterCameraVisable");
+        filterCameraVisable();
+    }
+    {
+        NARY_PROFILE_SCOPE("RenderScene::filterPointLightVisable");
+        filterPointLightVisable();
+    }
+    {
+        NARY_PROFILE_SCOPE("RenderScene::processDirectionalLight");
+        processDirectionalLight();
+    }
+    {
+        NARY_PROFILE_SCOPE("RenderScene::updateGlobalUbo");
+        updateGlobalUbo(resource);
+    }
 }
 
 void RenderScene::pickUpEntities(const Scene& scene, const RenderResource& resource) {
@@ -75,6 +92,7 @@ void RenderScene::filterCameraVisable() {
     });
 
     // sort to group by material
+    NARY_PROFILE_SCOPE("RenderScene::sort");
     std::sort(m_VisableEntities.begin(), m_VisableEntities.end(), [](auto&&a, auto&&b) {
         return a.material < b.material;
     });
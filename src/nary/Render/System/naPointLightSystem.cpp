@@ -6,6 +6,7 @@
 //
 
 #include "naPointLightSystem.hpp"
+#include "naLayoutCache.hpp"
 
 namespace nary {
 
@@ -15,24 +16,9 @@ naPointLightSystem::naPointLightSystem(naDevice& device, VkRenderPass renderPass
     createPipeline(renderPass);
 }
 
-naPointLightSystem::~naPointLightSystem() {
-    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
-}
-
 void naPointLightSystem::createPipelineLayout() {
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-        renderResource.getGlbalUboSetLayout()->get()
-    };
-    
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
-    if(vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS){
-        throw std::runtime_error("Failded to create pipeline layout!");
-    }
+    pipelineLayout = device.layoutCache().getPipelineLayout(
+        naPipeline::reflect("point_light_vertex.vert", "point_light_fragment.frag")).layout;
 }
 
 void naPointLightSystem::createPipeline(VkRenderPass renderPass){
@@ -44,7 +30,7 @@ void naPointLightSystem::createPipeline(VkRenderPass renderPass){
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = pipelineLayout;
     pipelineConfig.subpass = 1;
-    pipeline = std::make_unique<naPipeline>(device, "point_light_vertex.vert", "point_light_fragment.frag", pipelineConfig);
+    pipeline = naPipeline::create(device, "point_light_vertex.vert", "point_light_fragment.frag", pipelineConfig);
 }
 
 void naPointLightSystem::render(const RenderScene& scene, VkCommandBuffer commandBuffer) {
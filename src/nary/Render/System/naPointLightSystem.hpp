@@ -18,7 +18,6 @@ namespace nary {
 class naPointLightSystem {
 public:
     naPointLightSystem(naDevice& device, VkRenderPass renderPass, const RenderResource& renderResource);
-    ~naPointLightSystem();
     
     naPointLightSystem(const naPointLightSystem&) = delete;
     naPointLightSystem operator=(const naPointLightSystem&) = delete;
@@ -32,8 +31,8 @@ private:
     naDevice& device;
     const RenderResource& renderResource;
     
-    std::unique_ptr<naPipeline> pipeline;
-    VkPipelineLayout pipelineLayout;
+    std::shared_ptr<naPipeline> pipeline;
+    VkPipelineLayout pipelineLayout; // owned by the device's layout cache
 };
 
 }
@@ -6,36 +6,21 @@
 //
 
 #include "naRenderShaderOnly.hpp"
+#include "naLayoutCache.hpp"
 
 namespace nary {
 
 naRenderShaderOnly::naRenderShaderOnly(naDevice& device, VkRenderPass renderPass, const RenderResource& renderResource)
-: device(device), renderPass(renderPass), renderResource(renderResource) {
-    createPipelineLayout();
-}
-
-naRenderShaderOnly::~naRenderShaderOnly() {
-    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
-}
+: device(device), renderPass(renderPass), renderResource(renderResource) {}
 
-void naRenderShaderOnly::createPipelineLayout() {
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-        renderResource.getGlbalUboSetLayout()->get(),
-        renderResource.getOneImageSetLayout()->get()
-    };
-    
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
-    if(vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS){
-        throw std::runtime_error("Failded to create pipeline layout!");
-    }
+void naRenderShaderOnly::createPipelineLayout(const std::string& vertFile, const std::string& fragFile) {
+    // render() binds the global ubo and the input image whether the shaders read them or not
+    pipelineLayout = device.layoutCache().getPipelineLayout(naPipeline::reflect(vertFile, fragFile), 2).layout;
 }
 
 void naRenderShaderOnly::createPipeline(const std::string& vertFile, const std::string& fragFile, bool enableMSAA){
+    createPipelineLayout(vertFile, fragFile);
+    
     PipelineConfigInfo pipelineConfig{};
     naPipeline::defaultPiplineConfigInfo(pipelineConfig);
     naPipeline::enableAlphaBlending(pipelineConfig);
@@ -44,7 +29,7 @@ void naRenderShaderOnly::createPipeline(const std::string& vertFile, const std::
     pipelineConfig.attributeDescriptions.clear();
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = pipelineLayout;
-    pipeline.reset(new naPipeline(device, vertFile, fragFile, pipelineConfig));
+    pipeline = naPipeline::create(device, vertFile, fragFile, pipelineConfig);
 }
 
 naRenderShaderOnly& naRenderShaderOnly::setShaders(const std::string& vertFile, const std::string& fragFile, bool enableMSAA) {
@@ -15,7 +15,6 @@ namespace nary {
 class naRenderShaderOnly {
 public:
     naRenderShaderOnly(naDevice& device, VkRenderPass renderPass, const RenderResource& renderResource);
-    ~naRenderShaderOnly();
     
     naRenderShaderOnly(const naRenderShaderOnly&) = delete;
     naRenderShaderOnly operator=(const naRenderShaderOnly&) = delete;
@@ -30,14 +29,14 @@ public:
     naRenderShaderOnly& setShaders(const std::string& vertFile, const std::string& fragFile, bool enableMSAA = false);
     
 private:
-    void createPipelineLayout();
+    void createPipelineLayout(const std::string& vertFile, const std::string& fragFile);
     void createPipeline(const std::string& vertFile, const std::string& fragFile, bool enableMSAA);
     
     naDevice& device;
     const RenderResource& renderResource;
     
-    std::unique_ptr<naPipeline> pipeline = nullptr;
-    VkPipelineLayout pipelineLayout;
+    std::shared_ptr<naPipeline> pipeline = nullptr;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE; // owned by the device's layout cache
     VkRenderPass renderPass;
     
 };
@@ -6,60 +6,111 @@
 //
 
 #include "naRenderSystem.hpp"
+#include "naLayoutCache.hpp"
+
+#include <algorithm>
 
 namespace nary {
 
 struct SimplePushConstantData {
     mathpls::mat4 modelMatrix;
+    uint32_t materialIndex; // into the material storage buffer
 };
 
-naRenderSystem::naRenderSystem(naDevice& device, VkRenderPass renderPass, const RenderResource& renderResource)
-: device(device), renderResource(renderResource) {
-    createPipelineLayout();
-    createPipeline(renderPass);
+// point light loop bounds that get their own pipeline, a scene uses the smallest one covering its lights
+constexpr uint32_t POINT_LIGHT_BUCKETS[] = {0, 1, 2, 4, MAX_NUM_POINT_LIGHTS};
+
+uint32_t ForwardVariant::key() const {
+    return shadowed | textured << 1 | blend << 2 | doubleSided << 3 | bindless << 4 | maxPointLights << 5;
 }
 
-naRenderSystem::~naRenderSystem(){
-    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+ShaderPermutation ForwardVariant::permutation() const {
+    ShaderPermutation permutation;
+    if (shadowed) permutation.defines.push_back("SHADOWED");
+    if (textured) permutation.defines.push_back("TEXTURED");
+    if (blend) permutation.defines.push_back("IS_BLEND");
+    if (doubleSided) permutation.defines.push_back("DOUBLE_SIDED");
+    if (bindless) permutation.defines.push_back("BINDLESS");
+    permutation.constants.emplace_back(0, maxPointLights);
+    return permutation;
+}
+
+naRenderSystem::naRenderSystem(naDevice& device, VkRenderPass renderPass, const RenderResource& renderResource)
+: device(device), renderResource(renderResource), renderPass(renderPass) {
+    defaultVariant.bindless = renderResource.isBindless();
+    createPipelineLayout();
+    defaultPipeline = createPipeline(defaultVariant);
 }
 
 void naRenderSystem::createPipelineLayout(){
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
-    
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-        renderResource.getGlbalUboSetLayout()->get(),
-        renderResource.getOneImageSetLayout()->get(),
-        renderResource.getMaterialSetLayout()->get()
-    };
-    
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-    if(vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS){
-        throw std::runtime_error("Failded to create pipeline layout!");
-    }
+    // the variants only differ in code paths, they all share the layout of the default one
+    auto& layout = device.layoutCache().getPipelineLayout(
+        naPipeline::reflect("vertex.vert", "fragment.frag", defaultVariant.permutation().defines));
+    pipelineLayout = layout.layout;
+    pushConstantStages = layout.pushConstants.stageFlags;
 }
 
-void naRenderSystem::createPipeline(VkRenderPass renderPass){
+naPipeline* naRenderSystem::createPipeline(const ForwardVariant& variant){
     PipelineConfigInfo pipelineConfig{};
     naPipeline::defaultPiplineConfigInfo(pipelineConfig);
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = pipelineLayout;
     pipelineConfig.subpass = 1;
-    pipeline = std::make_unique<naPipeline>(device, "vertex.vert", "fragment.frag", pipelineConfig);
+    if (variant.blend) {
+        naPipeline::enableAlphaBlending(pipelineConfig);
+        pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    }
+    pipelineConfig.rasterizationInfo.cullMode = variant.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+    
+    auto& pipeline = pipelines[variant.key()];
+    pipeline = naPipeline::create(device, "vertex.vert", "fragment.frag", pipelineConfig, variant.permutation());
+    return pipeline.get();
+}
+
+ForwardVariant naRenderSystem::selectVariant(const Material& material, const RenderScene& renderScene) {
+    ForwardVariant variant;
+    variant.shadowed = renderScene.m_DirectionalLight.has_value();
+    variant.textured = material.base_color_texture != 0;
+    variant.blend = material.is_blend;
+    variant.doubleSided = material.is_double_side;
+    
+    auto numLights = static_cast<uint32_t>(renderScene.m_PointLights.size());
+    variant.maxPointLights = *std::find_if(std::begin(POINT_LIGHT_BUCKETS), std::end(POINT_LIGHT_BUCKETS) - 1,
+                                           [&](auto i) {return i >= numLights;});
+    return variant;
+}
+
+ForwardVariant naRenderSystem::getVariant(const Material& material, const RenderScene& renderScene) const {
+    auto variant = selectVariant(material, renderScene);
+    variant.bindless = defaultVariant.bindless;
+    return variant;
+}
+
+void naRenderSystem::preparePipelines(const RenderScene& renderScene) {
+    std::optional<UID> mtl;
+    for (auto& entity : renderScene.m_VisableEntities) {
+        if (mtl == entity.material) continue;
+        mtl = entity.material;
+        
+        auto variant = getVariant(*renderResource.getMaterial(*mtl), renderScene);
+        if (!pipelines.contains(variant.key()))
+            createPipeline(variant);
+    }
+}
+
+naPipeline* naRenderSystem::getPipeline(const Material& material, const RenderScene& renderScene) const {
+    auto it = pipelines.find(getVariant(material, renderScene).key());
+    return it != pipelines.end() ? it->second.get() : defaultPipeline;
 }
 
 void naRenderSystem::renderGameObjects(const RenderScene& renderScene, VkCommandBuffer commandBuffer, VkDescriptorSet shadowMapDescriptorSet) {
-    if (renderScene.m_VisableEntities.size() == 0)
-        return;
+    renderGameObjects(renderScene, commandBuffer, shadowMapDescriptorSet, 0, renderScene.m_VisableEntities.size());
+}
 
-    pipeline->bind(commandBuffer);
+void naRenderSystem::renderGameObjects(const RenderScene& renderScene, VkCommandBuffer commandBuffer, VkDescriptorSet shadowMapDescriptorSet, size_t begin, size_t end) {
+    end = std::min(end, renderScene.m_VisableEntities.size());
+    if (begin >= end)
+        return;
 
     VkDescriptorSet sets[2]{
         renderResource.getGlobalUboDescriptorSet(),
@@ -72,42 +123,47 @@ void naRenderSystem::renderGameObjects(const RenderScene& renderScene, VkCommand
                             sets,
                             0, nullptr);
 
+    // entities are sorted by material, so the pipeline and textures only change at group boundaries
     auto& entities = renderScene.m_VisableEntities;
-    auto mtl = entities.front().material;
-
-    while (true) {
-        // bind material descriptor sets
-        auto material_descriptor_set = renderResource.getMaterialDescriptorSet(mtl);
-        vkCmdBindDescriptorSets(commandBuffer,
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                pipelineLayout,
-                                2, 1,
-                                &material_descriptor_set,
-                                0, nullptr);
-
-        auto bng = std::lower_bound(entities.begin(), entities.end(), mtl, [](const RenderEntity& a, UID b) {
-            return a.material < b;
-        });
-        auto end = std::upper_bound(entities.begin(), entities.end(), mtl, [](UID a, const RenderEntity& b) {
-            return a < b.material;
-        });
-
-        for (; bng != end; ++bng) {
-            auto& entity = *bng;
-
-            // push constants
-            SimplePushConstantData push{};
-            push.modelMatrix = entity.modelMat;
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(SimplePushConstantData), &push);
-
-            entity.model->bind(commandBuffer);
-            entity.model->draw(commandBuffer);
+    std::optional<UID> mtl;
+    naPipeline* boundPipeline = nullptr;
+    VkDescriptorSet boundMaterialSet = VK_NULL_HANDLE;
+
+    for (auto i = begin; i < end; ++i) {
+        auto& entity = entities[i];
+
+        if (mtl != entity.material) {
+            mtl = entity.material;
+            
+            // pipelines share the layout, so the bound sets and push constants stay valid across a switch
+            auto pipeline = getPipeline(*renderResource.getMaterial(*mtl), renderScene);
+            if (pipeline != boundPipeline) {
+                pipeline->bind(commandBuffer);
+                boundPipeline = pipeline;
+            }
+            
+            // the parameters are indexed in set 0, set 2 only holds textures shared between materials,
+            // or all of them if bindless, then it's bound once
+            auto material_descriptor_set = renderResource.getMaterialDescriptorSet(*mtl);
+            if (material_descriptor_set != boundMaterialSet) {
+                vkCmdBindDescriptorSets(commandBuffer,
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        pipelineLayout,
+                                        2, 1,
+                                        &material_descriptor_set,
+                                        0, nullptr);
+                boundMaterialSet = material_descriptor_set;
+            }
         }
 
-        if (end == entities.end())
-            break;
-        else
-            mtl = end->material;
+        // push constants
+        SimplePushConstantData push{};
+        push.modelMatrix = entity.modelMat;
+        push.materialIndex = static_cast<uint32_t>(entity.material);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, 0, sizeof(SimplePushConstantData), &push);
+
+        entity.model->bind(commandBuffer);
+        entity.model->draw(commandBuffer);
     }
 }
 
@@ -12,27 +12,64 @@
 #include "RenderResource.hpp"
 #include "RenderScene.hpp"
 
+#include <unordered_map>
+
 namespace nary {
 
+/**
+ * the shader features a forward draw needs, every combination is its own pipeline
+ */
+struct ForwardVariant {
+    bool shadowed = true;
+    bool textured = true;
+    bool blend = false;
+    bool doubleSided = false;
+    bool bindless = false;  // textures are indexed in one array, see RenderResource::isBindless()
+    uint32_t maxPointLights = MAX_NUM_POINT_LIGHTS; // loop bound of the point lights, a specialization constant
+
+    uint32_t key() const;
+    ShaderPermutation permutation() const;
+};
+
 class naRenderSystem {
 public:
     naRenderSystem(naDevice& device, VkRenderPass renderPass, const RenderResource& renderResource);
-    ~naRenderSystem();
     
     naRenderSystem(const naRenderSystem&) = delete;
     naRenderSystem operator=(const naRenderSystem&) = delete;
     
     void renderGameObjects(const RenderScene& renderScene, VkCommandBuffer commandBuffer, VkDescriptorSet shadowMapDescriptorSet);
+    /**
+     * only draws the visable entities in [begin, end), so that the pass can be split across threads
+     */
+    void renderGameObjects(const RenderScene& renderScene, VkCommandBuffer commandBuffer, VkDescriptorSet shadowMapDescriptorSet, size_t begin, size_t end);
+    
+    /**
+     * creates the pipelines the visible materials need, call it before recording,
+     * a variant compiles once and is reused by every later frame
+     */
+    void preparePipelines(const RenderScene& renderScene);
+    
+    /**
+     * the cheapest variant that covers the material's features and the scene's lights
+     */
+    static ForwardVariant selectVariant(const Material& material, const RenderScene& renderScene);
     
 private:
     void createPipelineLayout();
-    void createPipeline(VkRenderPass renderPass);
+    naPipeline* createPipeline(const ForwardVariant& variant);
+    naPipeline* getPipeline(const Material& material, const RenderScene& renderScene) const;
+    ForwardVariant getVariant(const Material& material, const RenderScene& renderScene) const;
     
     naDevice& device;
     const RenderResource& renderResource;
+    VkRenderPass renderPass;
     
-    std::unique_ptr<naPipeline> pipeline;
-    VkPipelineLayout pipelineLayout;
+    std::unordered_map<uint32_t, std::shared_ptr<naPipeline>> pipelines; // by ForwardVariant::key()
+    ForwardVariant defaultVariant;
+    naPipeline* defaultPipeline;
+    VkPipelineLayout pipelineLayout; // owned by the device's layout cache
+    VkShaderStageFlags pushConstantStages;
 };
 
 }
@@ -6,6 +6,7 @@
 //
 
 #include "naShadowSystem.hpp"
+#include "naLayoutCache.hpp"
 
 namespace nary {
 
@@ -19,29 +20,10 @@ naShadowSystem::naShadowSystem(naDevice& device, VkRenderPass renderPass, const
     createPipeline(renderPass);
 }
 
-naShadowSystem::~naShadowSystem() {
-    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
-}
-
 void naShadowSystem::createPipelineLayout() {
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(ShadowPushConstantData);
-    
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-        renderResource.getGlbalUboSetLayout()->get()
-    };
-    
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-    if(vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS){
-        throw std::runtime_error("Failded to create pipeline layout!");
-    }
+    auto& layout = device.layoutCache().getPipelineLayout(naPipeline::reflect("shadow.vert", "shadow.frag"));
+    pipelineLayout = layout.layout;
+    pushConstantStages = layout.pushConstants.stageFlags;
 }
 
 void naShadowSystem::createPipeline(VkRenderPass renderPass) {
@@ -51,14 +33,24 @@ void naShadowSystem::createPipeline(VkRenderPass renderPass) {
     pipelineConfig.pipelineLayout = pipelineLayout;
 //    pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
     pipelineConfig.subpass = 0;
-    pipeline = std::make_unique<naPipeline>(device, "shadow.vert", "shadow.frag", pipelineConfig);
+    pipeline = naPipeline::create(device, "shadow.vert", "shadow.frag", pipelineConfig);
+}
+
+size_t naShadowSystem::getShadowCasterCount(const RenderScene& scene) {
+    if (!scene.m_DirectionalLight.has_value())
+        return 0;
+    return scene.m_DirectionalLightVisableEntities.size();
 }
 
 void naShadowSystem::renderGameObjects(const RenderScene& scene, VkCommandBuffer commandBuffer) {
     DEBUG_LOG("now {} objects cast shadow", scene.m_DirectionalLightVisableEntities.size());
+    renderGameObjects(scene, commandBuffer, 0, getShadowCasterCount(scene));
+}
 
-     if (!scene.m_DirectionalLight.has_value() || scene.m_DirectionalLightVisableEntities.empty())
-         return;
+void naShadowSystem::renderGameObjects(const RenderScene& scene, VkCommandBuffer commandBuffer, size_t begin, size_t end) {
+    end = std::min(end, getShadowCasterCount(scene));
+    if (begin >= end)
+        return;
 
     pipeline->bind(commandBuffer);
     
@@ -70,11 +62,13 @@ void naShadowSystem::renderGameObjects(const RenderScene& scene, VkCommandBuffer
                             &global_ubo,
                             0, nullptr);
     
-    for (auto& entity : scene.m_DirectionalLightVisableEntities) {
+    for (auto i = begin; i < end; ++i) {
+        auto& entity = scene.m_DirectionalLightVisableEntities[i];
+        
         ShadowPushConstantData push{};
         push.modelMatrix = entity.modelMat;
         
-        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(ShadowPushConstantData), &push);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, 0, sizeof(ShadowPushConstantData), &push);
         
         entity.model->bind(commandBuffer);
         entity.model->draw(commandBuffer);
@@ -18,12 +18,17 @@ namespace nary {
 class naShadowSystem {
 public:
     naShadowSystem(naDevice& device, VkRenderPass renderPass, const RenderResource& renderResource);
-    ~naShadowSystem();
     
     naShadowSystem(const naShadowSystem&) = delete;
     naShadowSystem operator=(const naShadowSystem&) = delete;
     
     void renderGameObjects(const RenderScene& scene, VkCommandBuffer commandBuffer);
+    /**
+     * only draws the shadow casters in [begin, end), so that the pass can be split across threads
+     */
+    void renderGameObjects(const RenderScene& scene, VkCommandBuffer commandBuffer, size_t begin, size_t end);
+    
+    static size_t getShadowCasterCount(const RenderScene& scene);
     
 private:
     void createPipelineLayout();
@@ -32,8 +37,9 @@ private:
     naDevice& device;
     const RenderResource& renderResource;
     
-    std::unique_ptr<naPipeline> pipeline;
-    VkPipelineLayout pipelineLayout;
+    std::shared_ptr<naPipeline> pipeline;
+    VkPipelineLayout pipelineLayout; // owned by the device's layout cache
+    VkShaderStageFlags pushConstantStages;
 };
 
 }
@@ -188,6 +188,11 @@ naFrameBuffer::Builder& naFrameBuffer::Builder::addDepthResources(uint32_t count
     return *this;
 }
 
+naFrameBuffer::Builder& naFrameBuffer::Builder::addColorUsage(VkImageUsageFlags usage) {
+    colorUsage |= usage;
+    return *this;
+}
+
 naFrameBuffer::Builder& naFrameBuffer::Builder::finishResourceAddition() {
     assert(attachments.size() == 0 && "This function cannot be called repeatedly!");
     
@@ -218,7 +223,7 @@ std::unique_ptr<naFrameBuffer> naFrameBuffer::Builder::build() {
            && "illegal image extent or forget to call 'setImageExtent'");
     assert(subpasses.size() > 0 && "forget to add subpasses");
     
-    return std::make_unique<naFrameBuffer>(device, subpasses, dependencies, attachments, imageCount, imageExtent);
+    return std::make_unique<naFrameBuffer>(device, subpasses, dependencies, attachments, imageCount, imageExtent, colorUsage);
 }
 
 naFrameBuffer::naFrameBuffer(naDevice& device,
@@ -226,8 +231,9 @@ naFrameBuffer::naFrameBuffer(naDevice& device,
                              std::span<const VkSubpassDependency> dependencies,
                              std::span<const VkAttachmentDescription> attachments,
                              uint32_t imageCount,
-                             VkExtent2D imageExtent)
-: device(device), m_Groups(imageCount), m_ImageExtent(imageExtent) {
+                             VkExtent2D imageExtent,
+                             VkImageUsageFlags colorUsage)
+: device(device), m_Groups(imageCount), m_ImageExtent(imageExtent), m_ColorUsage(colorUsage) {
     createRenderPass(subpasses, dependencies, attachments);
     createFrameBufferGroups(attachments);
 }
@@ -273,7 +279,7 @@ void naFrameBuffer::createFrameBufferGroups(std::span<const VkAttachmentDescript
                     
                 case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
                     // usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-                    usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+                    usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | m_ColorUsage;
                     break;
                     
                 default:
@@ -35,6 +35,10 @@ public:
         Builder& setImageExtent(VkExtent2D extent);
         Builder& addColorResources(uint32_t count, bool enableMSAA, VkFormat format);
         Builder& addDepthResources(uint32_t count, bool enableMSAA, VkFormat format);
+        /**
+         * extra usage for the sampled color images, e.g. TRANSFER_SRC to read them back
+         */
+        Builder& addColorUsage(VkImageUsageFlags usage);
         /**
          * Call this function before adding supasses.You cant add resources after calling it.
          */
@@ -79,6 +83,7 @@ public:
         
         uint32_t imageCount = 1;
         VkExtent2D imageExtent{};
+        VkImageUsageFlags colorUsage = 0;
     };
     
     naFrameBuffer(naDevice& device,
@@ -86,7 +91,8 @@ public:
                   std::span<const VkSubpassDependency> dependencies,
                   std::span<const VkAttachmentDescription> attachments,
                   uint32_t imageCount,
-                  VkExtent2D imageExtent);
+                  VkExtent2D imageExtent,
+                  VkImageUsageFlags colorUsage = 0);
     ~naFrameBuffer();
     naFrameBuffer(const naFrameBuffer&) = delete;
     naFrameBuffer& operator=(const naFrameBuffer&) = delete;
@@ -107,6 +113,7 @@ private:
     
     VkExtent2D m_ImageExtent;
     VkRenderPass m_RenderPass;
+    VkImageUsageFlags m_ColorUsage;
     
 private:
     
@@ -0,0 +1,131 @@
+#include "naGpuProfiler.hpp"
+
+#include "se_tools.h"
+
+#include <fstream>
+
+namespace nary {
+
+naGpuProfiler::naGpuProfiler(naDevice& device) : device(device) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device.physicalDevice(), &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(device.physicalDevice(), &count, families.data());
+
+    auto validBits = families[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+    if (validBits == 0 || device.properties.limits.timestampPeriod == 0) {
+        WARNING_LOG("GPU timestamps are not supported, the GPU profiler is disabled");
+        return;
+    }
+    m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    m_TimestampPeriod = device.properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = naSwapChain::MAX_FRAMES_IN_FLIGHT * MAX_ZONES * 2;
+    if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &m_QueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+}
+
+naGpuProfiler::~naGpuProfiler() {
+    if (m_QueryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device.device(), m_QueryPool, nullptr);
+}
+
+void naGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!isSupported()) return;
+
+    m_FrameIndex = frameIndex;
+    collect(frameIndex);
+
+    m_Zones[frameIndex].clear();
+    m_FrameNumbers[frameIndex] = m_FrameNumber++;
+    m_Depth = 0;
+    vkCmdResetQueryPool(commandBuffer, m_QueryPool, queryIndex(0), MAX_ZONES * 2);
+}
+
+void naGpuProfiler::collect(uint32_t frameIndex) {
+    auto& zones = m_Zones[frameIndex];
+    if (zones.empty()) return;
+
+    // value + availability for every query, zones that were never written are skipped
+    std::vector<uint64_t> data(zones.size() * 2 * 2);
+    vkGetQueryPoolResults(device.device(),
+                          m_QueryPool,
+                          frameIndex * MAX_ZONES * 2,
+                          static_cast<uint32_t>(zones.size() * 2),
+                          data.size() * sizeof(uint64_t),
+                          data.data(),
+                          2 * sizeof(uint64_t),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    FrameResult result;
+    result.frame = m_FrameNumbers[frameIndex];
+    for (size_t i = 0; i < zones.size(); ++i) {
+        auto begin = data.data() + i * 4;
+        auto end = begin + 2;
+        if (begin[1] == 0 || end[1] == 0)
+            continue;
+
+        auto ticks = (end[0] - begin[0]) & m_TimestampMask;
+        result.zones.push_back({zones[i].name, zones[i].depth, ticks * m_TimestampPeriod * 1e-6});
+    }
+
+    m_Latest = result;
+    m_History.push_back(std::move(result));
+    if (m_History.size() > HISTORY_SIZE)
+        m_History.pop_front();
+}
+
+uint32_t naGpuProfiler::allocateZone(const char* name) {
+    if (!isSupported()) return MAX_ZONES;
+
+    auto& zones = m_Zones[m_FrameIndex];
+    if (zones.size() >= MAX_ZONES)
+        return MAX_ZONES;
+
+    zones.push_back({name, m_Depth});
+    return static_cast<uint32_t>(zones.size() - 1);
+}
+
+void naGpuProfiler::writeBegin(VkCommandBuffer commandBuffer, uint32_t zone) const {
+    if (zone >= MAX_ZONES) return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, queryIndex(zone));
+}
+
+void naGpuProfiler::writeEnd(VkCommandBuffer commandBuffer, uint32_t zone) const {
+    if (zone >= MAX_ZONES) return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, queryIndex(zone) + 1);
+}
+
+bool naGpuProfiler::exportCSV(const std::string& filename) const {
+    std::ofstream file{filename};
+    if (!file.is_open()) {
+        WARNING_LOG("Failed to open file: {}", filename);
+        return false;
+    }
+
+    file << "frame,zone,depth,ms\n";
+    for (auto& frame : m_History)
+        for (auto& zone : frame.zones)
+            file << frame.frame << ',' << zone.name << ',' << zone.depth << ',' << zone.ms << '\n';
+
+    INFO_LOG("GPU profile of {} frames written to {}", m_History.size(), filename);
+    return true;
+}
+
+GpuZone::GpuZone(naGpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+: profiler(profiler), commandBuffer(commandBuffer) {
+    zone = profiler.allocateZone(name);
+    profiler.writeBegin(commandBuffer, zone);
+    ++profiler.m_Depth;
+}
+
+GpuZone::~GpuZone() {
+    --profiler.m_Depth;
+    profiler.writeEnd(commandBuffer, zone);
+}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "naDevice.hpp"
+#include "naSwapChain.hpp"
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace nary {
+
+/**
+ * GPU timestamp profiler.
+ * Every frame in flight owns a slice of one query pool, the slice is read back when that frame comes around again,
+ * i.e. after its fence was waited, so reading the results never stalls.
+ *
+ * Zones are allocated on the recording thread (allocateZone), the timestamps themselves can be written
+ * from any command buffer of the frame, including secondary ones recorded on workers.
+ */
+class naGpuProfiler {
+public:
+    static constexpr uint32_t MAX_ZONES = 64;
+    static constexpr size_t HISTORY_SIZE = 256;
+
+    struct ZoneResult {
+        const char* name;
+        uint32_t depth;
+        double ms;
+    };
+
+    struct FrameResult {
+        uint64_t frame = 0;
+        std::vector<ZoneResult> zones;
+    };
+
+    naGpuProfiler(naDevice& device);
+    ~naGpuProfiler();
+
+    naGpuProfiler(const naGpuProfiler&) = delete;
+    naGpuProfiler& operator=(const naGpuProfiler&) = delete;
+
+    /**
+     * collect the results of the last use of this frame slot and reset its queries,
+     * has to be recorded outside of a render pass
+     */
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    /**
+     * \param name has to outlive the profiler results, use string literals
+     * \return zone id, or MAX_ZONES when the frame is out of queries
+     */
+    uint32_t allocateZone(const char* name);
+    void writeBegin(VkCommandBuffer commandBuffer, uint32_t zone) const;
+    void writeEnd(VkCommandBuffer commandBuffer, uint32_t zone) const;
+
+    /**
+     * results of the latest frame that has been read back
+     */
+    const FrameResult& getLatest() const {return m_Latest;}
+    const std::deque<FrameResult>& getHistory() const {return m_History;}
+
+    /**
+     * write the history in "frame,zone,depth,ms" rows
+     */
+    bool exportCSV(const std::string& filename) const;
+
+    bool isSupported() const {return m_QueryPool != VK_NULL_HANDLE;}
+
+private:
+    struct ZoneInfo {
+        const char* name;
+        uint32_t depth;
+    };
+
+    void collect(uint32_t frameIndex);
+    uint32_t queryIndex(uint32_t zone) const {return (m_FrameIndex * MAX_ZONES + zone) * 2;}
+
+    naDevice& device;
+
+    VkQueryPool m_QueryPool = VK_NULL_HANDLE;
+    double m_TimestampPeriod; // ns per tick
+    uint64_t m_TimestampMask;
+
+    uint32_t m_FrameIndex = 0;
+    uint64_t m_FrameNumber = 0;
+    uint32_t m_Depth = 0;
+    std::array<std::vector<ZoneInfo>, naSwapChain::MAX_FRAMES_IN_FLIGHT> m_Zones;
+    std::array<uint64_t, naSwapChain::MAX_FRAMES_IN_FLIGHT> m_FrameNumbers{};
+
+    FrameResult m_Latest;
+    std::deque<FrameResult> m_History;
+
+    friend class GpuZone;
+};
+
+/**
+ * RAII marker, nested zones are indented in the UI
+ */
+class GpuZone {
+public:
+    GpuZone(naGpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name);
+    ~GpuZone();
+
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+    naGpuProfiler& profiler;
+    VkCommandBuffer commandBuffer;
+    uint32_t zone;
+};
+
+}
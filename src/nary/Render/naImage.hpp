@@ -9,6 +9,7 @@
 
 #include "naDevice.hpp"
 #include "naBuffer.hpp"
+#include "naUploadManager.hpp"
 
 #include <span>
 
@@ -35,30 +36,38 @@ public:
     VkImageView getView() const {return m_ImageView;}
     ImageInfo getInfo() const {return m_Info;}
     
+    /**
+     * upload ticket of the image data, 0 if the image wasn't created from data
+     */
+    UploadTicket getUploadTicket() const {return m_Ticket;}
+    /**
+     * bytes of device memory allocated for it
+     */
+    VkDeviceSize getMemorySize() const;
+    
     static naImage loadImageFromFile(naDevice& device, std::string_view filename);
     static naImage createWithImageData(naDevice& device, std::span<const uint8_t> data, const ImageInfo& info);
     
     /**
-     * create a original Vulkan image.
+     * create a original Vulkan image, its memory comes from the device's VMA allocator.
+     * free both with vmaDestroyImage()
      */
-    static void createImage(naDevice& device, const ImageInfo& info, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+    static void createImage(naDevice& device, const ImageInfo& info, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VmaAllocation& allocation);
     
 private:
     
     static uint8_t* loadImageFile(std::string_view filename, ImageInfo& info);
-    static std::unique_ptr<naBuffer> stageBuffer(naDevice& device, std::span<const uint8_t> data);
     
-    void generateMipmaps();
-    void transitionImageLayout(VkImageLayout newLayout);
-    void copyBufferToImage(const naBuffer& buffer);
+    void upload(std::span<const uint8_t> data, bool generateMipmaps);
     
     void createImageView();
     
 private:
     VkImage m_Image = VK_NULL_HANDLE;
-    VkDeviceMemory m_ImageMemory = VK_NULL_HANDLE;
+    VmaAllocation m_Allocation = VK_NULL_HANDLE;
     VkImageView m_ImageView = VK_NULL_HANDLE;
     VkImageLayout m_Layout;
+    UploadTicket m_Ticket = 0;
     
     ImageInfo m_Info;
     
@@ -15,6 +15,7 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include <cassert>
 #include <filesystem>
 #include <unordered_map>
 #include <random>
@@ -32,12 +33,19 @@ struct hash<nary::naModel::Vertex> {
 
 namespace nary {
 
-naModel::naModel(naDevice& device, const Builder& builder) : device(device) {
+naModel::naModel(naDevice& device, const Builder& builder) : device(&device) {
     createBoundingSphere(builder.vertices);
     createVertexBuffers(builder.vertices);
     createIndexBuffers(builder.indices);
 }
 
+naModel::naModel(const Builder& builder) {
+    createBoundingSphere(builder.vertices);
+    vertexCount = static_cast<uint32_t>(builder.vertices.size());
+    indexCount = static_cast<uint32_t>(builder.indices.size());
+    hasIndexBuffer = indexCount > 0;
+}
+
 std::unique_ptr<naModel> naModel::createModelFromFile(naDevice& device, const std::string& filepath) {
     Builder builder;
     builder.loadModel(filepath);
@@ -47,6 +55,12 @@ std::unique_ptr<naModel> naModel::createModelFromFile(naDevice& device, const st
     return std::make_unique<naModel>(device, builder);
 }
 
+std::unique_ptr<naModel> naModel::createNullModelFromFile(const std::string& filepath) {
+    Builder builder;
+    builder.loadModel(filepath);
+    return std::make_unique<naModel>(builder);
+}
+
 void naModel::Builder::loadModel(std::string_view filepath) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
@@ -106,25 +120,7 @@ void naModel::createVertexBuffers(const std::vector<Vertex> &vertices){
     vertexCount = static_cast<uint32_t>(vertices.size());
     constexpr uint32_t vertexSize = sizeof(Vertex);
     
-    naBuffer stagingBuffer{
-        device,
-        vertexSize,
-        vertexCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    };
-    
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void*)vertices.data());
-    
-    vertexBuffer = std::make_unique<naBuffer>(
-        device,
-        vertexSize,
-        vertexCount,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    
-    device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), vertexSize * vertexCount);
+    vertexBuffer = createBuffer(vertices.data(), vertexSize, vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 }
 
 void naModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
@@ -133,25 +129,27 @@ void naModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
     
     constexpr VkDeviceSize indexSize = sizeof(uint32_t);
     
-    naBuffer stagingBuffer{
-        device,
-        indexSize,
-        indexCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    };
-    
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void*)indices.data());
-    
-    indexBuffer = std::make_unique<naBuffer>(
-        device,
-        indexSize,
-        indexCount,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    indexBuffer = createBuffer(indices.data(), indexSize, indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+std::unique_ptr<naBuffer> naModel::createBuffer(const void* data, VkDeviceSize instanceSize, uint32_t instanceCount, VkBufferUsageFlags usage) {
+    auto size = instanceSize * instanceCount;
+    if (device->directUploads()) {
+        // no staging copy and no transfer, the host writes are visible to every later submission
+        auto buffer = std::make_unique<naBuffer>(*device, instanceSize, instanceCount, usage,
+                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        buffer->map();
+        buffer->writeToBuffer(const_cast<void*>(data), size);
+        if (!(buffer->getMemoryPropertyFlags() & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+            buffer->flush();
+        buffer->unmap();
+        return buffer;
+    }
     
-    device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), indexSize * indexCount);
+    auto buffer = std::make_unique<naBuffer>(*device, instanceSize, instanceCount, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uploadTicket = device->uploader().uploadBuffer(buffer->getBuffer(), data, size);
+    return buffer;
 }
 
 void naModel::createBoundingSphere(const std::vector<Vertex>& vertices) {
@@ -171,6 +169,7 @@ void naModel::createBoundingSphere(const std::vector<Vertex>& vertices) {
 }
 
 void naModel::draw(VkCommandBuffer commandBufffer){
+    assert(!isNull() && "Can't draw a null model");
     if (hasIndexBuffer) {
         vkCmdDrawIndexed(commandBufffer, indexCount, 1, 0, 0, 0);
     } else {
@@ -178,6 +177,10 @@ void naModel::draw(VkCommandBuffer commandBufffer){
     }
 }
 
+VkDeviceSize naModel::getMemorySize() const {
+    return (vertexBuffer ? vertexBuffer->getBufferSize() : 0) + (indexBuffer ? indexBuffer->getBufferSize() : 0);
+}
+
 void naModel::bind(VkCommandBuffer commandBufffer){
     VkBuffer buffers[] = {vertexBuffer->getBuffer()};
     VkDeviceSize offsets[] = {0};
@@ -9,6 +9,7 @@
 
 #include "naDevice.hpp"
 #include "naBuffer.hpp"
+#include "naUploadManager.hpp"
 
 #include "mathpls.h"
 #include "Geometry.hpp"
@@ -42,9 +43,14 @@ public:
     };
     
     naModel(naDevice& device, const Builder& builder);
+    /**
+     * metadata only model for the null backend, no GPU buffers are created and it can't be drawn
+     */
+    explicit naModel(const Builder& builder);
     ~naModel() = default;
     
     static std::unique_ptr<naModel> createModelFromFile(naDevice& device, const std::string& filepath);
+    static std::unique_ptr<naModel> createNullModelFromFile(const std::string& filepath);
     
     naModel(const naModel&) = delete;
     naModel operator=(const naModel&) = delete;
@@ -53,14 +59,27 @@ public:
     void draw(VkCommandBuffer commandBufffer);
 
     pxpls::Sphere getBoundingSphere() const {return meshBoundingSphere;}
+    uint32_t getVertexCount() const {return vertexCount;}
+    uint32_t getIndexCount() const {return indexCount;}
+    /**
+     * vertices a draw of this model processes
+     */
+    uint32_t getDrawCount() const {return hasIndexBuffer ? indexCount : vertexCount;}
+    bool isNull() const {return device == nullptr;}
+    UploadTicket getUploadTicket() const {return uploadTicket;}
+    /**
+     * bytes of its vertex and index buffers, 0 for the null backend
+     */
+    VkDeviceSize getMemorySize() const;
     
 private:
     void createVertexBuffers(const std::vector<Vertex>& vertices);
     void createIndexBuffers(const std::vector<uint32_t>& indices);
+    std::unique_ptr<naBuffer> createBuffer(const void* data, VkDeviceSize instanceSize, uint32_t instanceCount, VkBufferUsageFlags usage);
 
     void createBoundingSphere(const std::vector<Vertex>& vertices);
     
-    naDevice& device;
+    naDevice* device = nullptr;
     
     std::unique_ptr<naBuffer> vertexBuffer;
     uint32_t vertexCount;
@@ -70,6 +89,8 @@ private:
     bool hasIndexBuffer;
     std::unique_ptr<naBuffer> indexBuffer;
     uint32_t indexCount;
+    
+    UploadTicket uploadTicket = 0; // of the last buffer uploaded, batches finish in order, 0 if written in place
 };
 
 }
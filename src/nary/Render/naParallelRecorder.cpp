@@ -0,0 +1,116 @@
+#include "naParallelRecorder.hpp"
+#include "naProfiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace nary {
+
+naParallelRecorder::naParallelRecorder(naDevice& device, naThreadPool& threadPool)
+: device(device), threadPool(threadPool) {
+    createCommandPools();
+}
+
+naParallelRecorder::~naParallelRecorder() {
+    for (auto& frame : m_Pools)
+        for (auto& i : frame)
+            vkDestroyCommandPool(device.device(), i.pool, nullptr); // frees its command buffers as well
+}
+
+void naParallelRecorder::createCommandPools() {
+    auto queueFamilyIndices = device.findPhysicalQueueFamilies();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // reset as a whole every frame
+
+    for (auto& frame : m_Pools) {
+        frame.resize(threadPool.size() + 1);
+        for (auto& i : frame) {
+            if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &i.pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create worker command pool!");
+            }
+        }
+    }
+}
+
+void naParallelRecorder::beginFrame(uint32_t frameIndex) {
+    m_FrameIndex = frameIndex;
+    for (auto& i : m_Pools[frameIndex]) {
+        if (i.used == 0) continue;
+        vkResetCommandPool(device.device(), i.pool, 0);
+        i.used = 0;
+    }
+}
+
+VkCommandBuffer naParallelRecorder::allocateSecondary(uint32_t threadIndex) {
+    auto& pool = m_Pools[m_FrameIndex][threadIndex];
+    if (pool.used == pool.buffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = pool.pool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate secondary command buffer!");
+        }
+        pool.buffers.push_back(commandBuffer);
+    } // buffers are kept and reused after the pool is reset
+    return pool.buffers[pool.used++];
+}
+
+VkCommandBuffer naParallelRecorder::beginSecondary(uint32_t threadIndex, const VkCommandBufferInheritanceInfo& inheritance) {
+    auto commandBuffer = allocateSecondary(threadIndex);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording secondary command buffer!");
+    }
+    return commandBuffer;
+}
+
+void naParallelRecorder::record(VkCommandBuffer primary,
+                                const VkCommandBufferInheritanceInfo& inheritance,
+                                size_t count,
+                                size_t minChunkSize,
+                                const RecordFn& fn) {
+    if (count == 0) return;
+    NARY_PROFILE_SCOPE("naParallelRecorder::record");
+
+    minChunkSize = std::max<size_t>(minChunkSize, 1);
+    size_t chunkCount = std::min<size_t>(threadPool.size(), (count + minChunkSize - 1) / minChunkSize);
+
+    m_Secondaries.assign(chunkCount, VK_NULL_HANDLE);
+
+    if (chunkCount <= 1) {
+        // not worth waking the workers up
+        auto commandBuffer = beginSecondary(threadPool.size(), inheritance);
+        fn(commandBuffer, 0, count);
+        vkEndCommandBuffer(commandBuffer);
+        m_Secondaries[0] = commandBuffer;
+    } else {
+        threadPool.parallelFor(count, chunkCount, [&](size_t begin, size_t end, size_t chunk) {
+            NARY_PROFILE_SCOPE("naParallelRecorder::recordChunk");
+            auto threadIndex = threadPool.workerIndex();
+            assert(threadIndex < threadPool.size());
+
+            auto commandBuffer = beginSecondary(threadIndex, inheritance);
+            fn(commandBuffer, begin, end);
+            vkEndCommandBuffer(commandBuffer);
+            m_Secondaries[chunk] = commandBuffer;
+        });
+    }
+
+    // parallelFor may produce fewer chunks than requested
+    std::erase(m_Secondaries, VK_NULL_HANDLE);
+    vkCmdExecuteCommands(primary, static_cast<uint32_t>(m_Secondaries.size()), m_Secondaries.data());
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "naDevice.hpp"
+#include "naSwapChain.hpp"
+#include "naThreadPool.hpp"
+
+#include <array>
+#include <functional>
+#include <vector>
+
+namespace nary {
+
+/**
+ * Records large passes into secondary command buffers on the worker threads.
+ * Every worker (and the calling thread) owns one command pool per frame in flight,
+ * all pools of a frame are reset together in beginFrame().
+ */
+class naParallelRecorder {
+public:
+    using RecordFn = std::function<void(VkCommandBuffer commandBuffer, size_t begin, size_t end)>;
+
+    naParallelRecorder(naDevice& device, naThreadPool& threadPool);
+    ~naParallelRecorder();
+
+    naParallelRecorder(const naParallelRecorder&) = delete;
+    naParallelRecorder& operator=(const naParallelRecorder&) = delete;
+
+    /**
+     * call it after the frame's fence has been waited, it resets all the pools of this frame
+     */
+    void beginFrame(uint32_t frameIndex);
+
+    /**
+     * Split [0, count) into chunks of at least `minChunkSize` items, record each chunk into a secondary
+     * command buffer in parallel and execute them from `primary` in order.
+     * The current subpass of `primary` must be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+     * @note secondary command buffers inherit no state, `fn` has to set viewport, pipeline and descriptor sets itself
+     */
+    void record(VkCommandBuffer primary,
+                const VkCommandBufferInheritanceInfo& inheritance,
+                size_t count,
+                size_t minChunkSize,
+                const RecordFn& fn);
+
+    uint32_t getThreadCount() const {return threadPool.size();}
+
+private:
+    struct ThreadCommandPool {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> buffers;
+        size_t used = 0;
+    };
+
+    VkCommandBuffer allocateSecondary(uint32_t threadIndex);
+    VkCommandBuffer beginSecondary(uint32_t threadIndex, const VkCommandBufferInheritanceInfo& inheritance);
+
+    void createCommandPools();
+
+    naDevice& device;
+    naThreadPool& threadPool;
+
+    // [frame][worker], the last slot of each frame is used by the calling (main) thread
+    std::array<std::vector<ThreadCommandPool>, naSwapChain::MAX_FRAMES_IN_FLIGHT> m_Pools;
+    uint32_t m_FrameIndex = 0;
+
+    std::vector<VkCommandBuffer> m_Secondaries;
+};
+
+}
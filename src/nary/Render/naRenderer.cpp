@@ -6,20 +6,56 @@
 //
 
 #include "naRenderer.hpp"
+#include "naProfiler.hpp"
+
+#include "se_tools.h"
 
 namespace nary {
 
 naRenderer::naRenderer(naWin& window, naDevice& device)
-: window(window), device(device) {
+: window(&window), device(device) {
     recreateSwapChain();
     createCommandBuffer();
     createFrameBuffer();
 }
 
+naRenderer::naRenderer(naDevice& device, VkExtent2D extent)
+: device(device), m_Extent(extent) {
+    createOutputBuffer();
+    createCommandBuffer();
+    createFrameBuffer();
+}
+
 naRenderer::~naRenderer(){
+    waitForFrames();
+    if (isHeadless()) {
+        for (auto fence : m_InFlightFences)
+            vkDestroyFence(device.device(), fence, nullptr);
+    }
     freeCommandBuffers();
 }
 
+VkRenderPass naRenderer::getSwapChainRenderPass() const {
+    return isHeadless() ? m_OutputBuffer->getRenderPass() : swapChain->getRenderPass();
+}
+
+VkImageView naRenderer::getSwapChainImageView(int index) const {
+    return isHeadless() ? m_OutputBuffer->getGroup(index).images[0].getView() : swapChain->getImageView(index);
+}
+
+VkFormat naRenderer::getSwapChainImageFormat() const {
+    return isHeadless() ? HEADLESS_FORMAT : swapChain->getSwapChainImageFormat();
+}
+
+VkExtent2D naRenderer::getSwapChainExtent() const {
+    return isHeadless() ? m_Extent : swapChain->getSwapChainExtent();
+}
+
+float naRenderer::getAspectRatio() const {
+    auto extent = getSwapChainExtent();
+    return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+}
+
 void naRenderer::createCommandBuffer(){
     commandBuffers.resize(naSwapChain::MAX_FRAMES_IN_FLIGHT);
     VkCommandBufferAllocateInfo allocInfo{};
@@ -33,25 +69,32 @@ void naRenderer::createCommandBuffer(){
 }
 
 void naRenderer::recreateSwapChain(){
-    auto extent = window.getExtent();
+    auto extent = window->getExtent();
     while (extent.width == 0 || extent.height == 0) {
-        extent = window.getExtent();
+        extent = window->getExtent();
         glfwWaitEvents();
     }
     
-    vkDeviceWaitIdle(device.device());
-    
     if (swapChain == nullptr)
         swapChain = std::make_unique<naSwapChain>(device, extent);
     else{
+        // the new swap chain takes over the frame fences, frames in flight may still render into the old images
         std::shared_ptr<naSwapChain> oldSwapChain = std::move(swapChain);
         swapChain = std::make_unique<naSwapChain>(device, extent, oldSwapChain);
         if (!oldSwapChain->compareSwapFormats(*swapChain.get())) {
             throw std::runtime_error("Swap chain image(or depth) format has changed!");
         }
+        device.deferDestroy([oldSwapChain = std::move(oldSwapChain)]() mutable { oldSwapChain.reset(); });
     }
 }
 
+void naRenderer::waitForFrames() {
+    if (isHeadless())
+        vkWaitForFences(device.device(), static_cast<uint32_t>(m_InFlightFences.size()), m_InFlightFences.data(), VK_TRUE, UINT64_MAX);
+    else
+        swapChain->waitForFrames();
+}
+
 void naRenderer::createFrameBuffer() {
     VkSubpassDependency dependency{};
     dependency.dstSubpass = 1;
@@ -65,10 +108,10 @@ void naRenderer::createFrameBuffer() {
     
     m_FrameBuffer = naFrameBuffer::Builder(device)
         .setImageCount(naSwapChain::MAX_FRAMES_IN_FLIGHT)
-        .setImageExtent(swapChain->getSwapChainExtent())
-        .addColorResources(1, true, swapChain->getSwapChainImageFormat())
+        .setImageExtent(getSwapChainExtent())
+        .addColorResources(1, true, getSwapChainImageFormat())
         .addColorResources(1, true, VK_FORMAT_R8_UNORM)
-        .addDepthResources(2, true, swapChain->findDepthFormat())
+        .addDepthResources(2, true, naSwapChain::findDepthFormat(device))
         .finishResourceAddition()
         .addSubpass({}, {1}, 1)
         .addSubpass({3}, {0}, 0)
@@ -76,6 +119,95 @@ void naRenderer::createFrameBuffer() {
         .build();
 }
 
+void naRenderer::createOutputBuffer() {
+    m_OutputBuffer = naFrameBuffer::Builder(device)
+        .setImageCount(naSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .setImageExtent(m_Extent)
+        .addColorResources(1, false, HEADLESS_FORMAT)
+        .addColorUsage(VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        .finishResourceAddition()
+        .addSubpass({}, {0})
+        .build();
+    
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    m_InFlightFences.resize(naSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (auto& fence : m_InFlightFences) {
+        if (vkCreateFence(device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
+    }
+    m_ReadbackRecorded.resize(naSwapChain::MAX_FRAMES_IN_FLIGHT, false);
+}
+
+void naRenderer::setReadback(bool enable) {
+    assert(isHeadless() && "Readback is only supported by the headless renderer");
+    m_Readback = enable;
+    
+    if (enable && m_ReadbackBuffers.empty()) {
+        LOOP (naSwapChain::MAX_FRAMES_IN_FLIGHT) {
+            auto& buffer = m_ReadbackBuffers.emplace_back(std::make_unique<naBuffer>(device,
+                                                                                     4,
+                                                                                     m_Extent.width * m_Extent.height,
+                                                                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+            buffer->map();
+        }
+    }
+}
+
+void naRenderer::recordReadback(VkCommandBuffer commandBuffer) {
+    auto image = m_OutputBuffer->getGroup(currentFrameIndex).images[0].get();
+    
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+    
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {m_Extent.width, m_Extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer,
+                           image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           m_ReadbackBuffers[currentFrameIndex]->getBuffer(),
+                           1, &region);
+    
+    // make the copy visible to the host once the fence is waited
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+}
+
+bool naRenderer::readLastFrame(std::vector<uint8_t>& pixels) {
+    assert(isHeadless() && "Readback is only supported by the headless renderer");
+    if (m_LastSubmittedFrame < 0 || !m_ReadbackRecorded[m_LastSubmittedFrame])
+        return false;
+    
+    vkWaitForFences(device.device(), 1, &m_InFlightFences[m_LastSubmittedFrame], VK_TRUE, UINT64_MAX);
+    
+    auto& buffer = m_ReadbackBuffers[m_LastSubmittedFrame];
+    auto data = static_cast<const uint8_t*>(buffer->getMappedMemory());
+    pixels.assign(data, data + buffer->getBufferSize());
+    return true;
+}
+
 void naRenderer::freeCommandBuffers(){
     vkFreeCommandBuffers(device.device(), device.getCommandPool(), static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
     commandBuffers.clear();
@@ -83,15 +215,21 @@ void naRenderer::freeCommandBuffers(){
 
 VkCommandBuffer naRenderer::beginFrame() {
     assert(!isFrameStarted && "Can't call beginFrame while already in progress");
+    NARY_PROFILE_SCOPE("naRenderer::beginFrame");
 
-    auto result = swapChain->acquireNextImage(&currentImageIndex);
-    
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapChain();
-        return nullptr;
-    }
-    if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR){
-        throw std::runtime_error("Failed to acquire swap chain image!");
+    if (isHeadless()) {
+        vkWaitForFences(device.device(), 1, &m_InFlightFences[currentFrameIndex], VK_TRUE, UINT64_MAX);
+        currentImageIndex = currentFrameIndex;
+    } else {
+        auto result = swapChain->acquireNextImage(&currentImageIndex);
+        
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapChain();
+            return nullptr;
+        }
+        if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR){
+            throw std::runtime_error("Failed to acquire swap chain image!");
+        }
     }
     
     isFrameStarted = true;
@@ -107,24 +245,44 @@ VkCommandBuffer naRenderer::beginFrame() {
 
 void naRenderer::endFrame() {
     assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
+    NARY_PROFILE_SCOPE("naRenderer::endFrame (submit & present)");
     auto commandBuffer = getCurrentCommandBuffer();
     
+    if (isHeadless()) {
+        m_ReadbackRecorded[currentFrameIndex] = m_Readback;
+        if (m_Readback)
+            recordReadback(commandBuffer);
+    }
+    
     if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
         throw std::runtime_error("Failed to record command buffer!");
     }
     
-    auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized()) {
-        recreateSwapChain();
-    } else if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to present swap chain image!");
+    if (isHeadless()) {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        
+        vkResetFences(device.device(), 1, &m_InFlightFences[currentFrameIndex]);
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, m_InFlightFences[currentFrameIndex]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        m_LastSubmittedFrame = currentFrameIndex;
+    } else {
+        auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window->wasWindowResized()) {
+            recreateSwapChain();
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to present swap chain image!");
+        }
     }
     
     isFrameStarted = false;
     currentFrameIndex = (currentFrameIndex + 1) % naSwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
-void naRenderer::beginRenderPass() {
+void naRenderer::beginRenderPass(VkSubpassContents contents) {
     assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
     
     auto commandBuffer = getCurrentCommandBuffer();
@@ -148,8 +306,13 @@ void naRenderer::beginRenderPass() {
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValue.size());
     renderPassInfo.pClearValues = clearValue.data();
     
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
     
+    if (contents == VK_SUBPASS_CONTENTS_INLINE)
+        setViewport(commandBuffer);
+}
+
+void naRenderer::setViewport(VkCommandBuffer commandBuffer) const {
     VkViewport viewport{};
     viewport.x = 0.f;
     viewport.y = 0.f;
@@ -162,6 +325,17 @@ void naRenderer::beginRenderPass() {
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
+VkCommandBufferInheritanceInfo naRenderer::getInheritanceInfo(uint32_t subpass) const {
+    assert(isFrameStarted && "Can't get inheritance info if frame is not in progress");
+    
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = getRenderPass();
+    inheritanceInfo.subpass = subpass;
+    inheritanceInfo.framebuffer = m_FrameBuffer->get(currentFrameIndex);
+    return inheritanceInfo;
+}
+
 void naRenderer::endRenderPass() {
     assert(isFrameStarted && "Can't call endSwapChainRenderPass if frame is not in progress");
     vkCmdEndRenderPass(getCurrentCommandBuffer());
@@ -174,10 +348,11 @@ void naRenderer::beginSwapChainRenderPass() {
     
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = swapChain->getRenderPass();
-    renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
+    auto extent = getSwapChainExtent();
+    renderPassInfo.renderPass = getSwapChainRenderPass();
+    renderPassInfo.framebuffer = isHeadless() ? m_OutputBuffer->get(currentImageIndex) : swapChain->getFrameBuffer(currentImageIndex);
     renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapChain->getSwapChainExtent();
+    renderPassInfo.renderArea.extent = extent;
     
     std::array<VkClearValue, 2> clearValue{};
     clearValue[0].color = {
@@ -193,12 +368,12 @@ void naRenderer::beginSwapChainRenderPass() {
     
     VkViewport viewport{};
     viewport.x = 0.f;
-    viewport.y = static_cast<float>(swapChain->getSwapChainExtent().height);
-    viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-    viewport.height =-static_cast<float>(swapChain->getSwapChainExtent().height);
+    viewport.y = static_cast<float>(extent.height);
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height =-static_cast<float>(extent.height);
     viewport.maxDepth = 1.f;
     viewport.minDepth = 0.f;
-    VkRect2D scissor{{0, 0}, swapChain->getSwapChainExtent()};
+    VkRect2D scissor{{0, 0}, extent};
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
@@ -208,9 +383,9 @@ void naRenderer::endSwapChainRenderPass() {
     vkCmdEndRenderPass(getCurrentCommandBuffer());
 }
 
-void naRenderer::nextSubpass() const {
+void naRenderer::nextSubpass(VkSubpassContents contents) const {
     assert(isFrameStarted && "Can't call nextSubpass if frame is not in progress");
-    vkCmdNextSubpass(getCurrentCommandBuffer(), VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdNextSubpass(getCurrentCommandBuffer(), contents);
 }
 
 }
@@ -11,21 +11,29 @@
 #include "naSwapChain.hpp"
 #include "naGameObject.hpp"
 #include "naFrameBuffer.hpp"
+#include "naBuffer.hpp"
 
 namespace nary {
 class naRenderer {
 public:
+    static constexpr VkFormat HEADLESS_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
     naRenderer(naWin& window, naDevice& device);
+    /**
+     * headless renderer, the final pass renders into offscreen images and nothing is presented
+     */
+    naRenderer(naDevice& device, VkExtent2D extent);
     ~naRenderer();
     
     naRenderer(const naRenderer&) = delete;
     naRenderer operator=(const naRenderer&) = delete;
     
-    VkRenderPass getSwapChainRenderPass() {return swapChain->getRenderPass();}
-    VkImageView getSwapChainImageView(int index) {return swapChain->getImageView(index);}
-    VkFormat getSwapChainImageFormat() {return swapChain->getSwapChainImageFormat();}
-    VkExtent2D getSwapChainExtent() {return swapChain->getSwapChainExtent();}
-    float getAspectRatio() const {return swapChain->extentAspectRatio();}
+    bool isHeadless() const {return window == nullptr;}
+    VkRenderPass getSwapChainRenderPass() const;
+    VkImageView getSwapChainImageView(int index) const;
+    VkFormat getSwapChainImageFormat() const;
+    VkExtent2D getSwapChainExtent() const;
+    float getAspectRatio() const;
     bool isFrameInProgress() const {return isFrameStarted;}
     VkRenderPass getRenderPass() const {return m_FrameBuffer->getRenderPass();}
     naFrameBuffer& getFrameBuffer() {return *m_FrameBuffer;}
@@ -42,21 +50,54 @@ public:
     
     VkCommandBuffer beginFrame();
     void endFrame();
-    void beginRenderPass();
+    void beginRenderPass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void endRenderPass();
     void beginSwapChainRenderPass();
     void endSwapChainRenderPass();
-    void nextSubpass() const;
+    void nextSubpass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE) const;
+    
+    /**
+     * set the viewport and scissor of the offscreen render pass,
+     * secondary command buffers don't inherit them from the primary one
+     */
+    void setViewport(VkCommandBuffer commandBuffer) const;
+    VkCommandBufferInheritanceInfo getInheritanceInfo(uint32_t subpass) const;
+    
+    /**
+     * headless only, copy the output of every following frame into host memory
+     */
+    void setReadback(bool enable);
+    /**
+     * wait for the latest submitted frame and copy its pixels (HEADLESS_FORMAT, tightly packed rows) into pixels
+     * \return false if that frame wasn't read back
+     */
+    bool readLastFrame(std::vector<uint8_t>& pixels);
+    
+    /**
+     * blocks until every submitted frame has finished, e.g. before shutting down
+     */
+    void waitForFrames();
     
 private:
     void createCommandBuffer();
     void freeCommandBuffers();
     void recreateSwapChain();
     void createFrameBuffer();
+    void createOutputBuffer();
+    void recordReadback(VkCommandBuffer commandBuffer);
     
-    naWin& window;
+    naWin* window = nullptr;
     naDevice& device;
     std::unique_ptr<naSwapChain> swapChain;
+    
+    // replace the swap chain when headless
+    VkExtent2D m_Extent{};
+    std::unique_ptr<naFrameBuffer> m_OutputBuffer;
+    std::vector<VkFence> m_InFlightFences;
+    std::vector<std::unique_ptr<naBuffer>> m_ReadbackBuffers;
+    std::vector<bool> m_ReadbackRecorded;
+    bool m_Readback = false;
+    int m_LastSubmittedFrame = -1;
     std::vector<VkCommandBuffer> commandBuffers;
     
     std::unique_ptr<naFrameBuffer> m_FrameBuffer;
@@ -1,16 +1,263 @@
 #include "RenderManager.hpp"
+#include "naThreadPool.hpp"
+#include "naUploadManager.hpp"
+#include "se_tools.h"
 
 namespace nary {
 
+void RefCounts::retain(UID id) {
+    std::lock_guard lock{m_Mutex};
+    ++m_Counts[id];
+}
+
+void RefCounts::release(UID id) {
+    std::lock_guard lock{m_Mutex};
+    auto it = m_Counts.find(id);
+    if (it == m_Counts.end()) return;
+    if (--it->second == 0) {
+        m_Counts.erase(it);
+        m_Released.push_back(id);
+    }
+}
+
+uint32_t RefCounts::count(UID id) const {
+    std::lock_guard lock{m_Mutex};
+    auto it = m_Counts.find(id);
+    return it == m_Counts.end() ? 0 : it->second;
+}
+
+std::vector<UID> RefCounts::takeReleased() {
+    std::lock_guard lock{m_Mutex};
+    return std::exchange(m_Released, {});
+}
+
+static std::string error_message(const std::exception_ptr& error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        return e.what();
+    } catch (...) {
+        return "unknown error";
+    }
+}
+
+static std::shared_future<void> ready_future() {
+    std::promise<void> promise;
+    promise.set_value();
+    return promise.get_future().share();
+}
+
 AssetManager::AssetManager(RenderManager& renderManager)
-: pRenderManager(&renderManager) {}
+: pRenderManager(&renderManager), m_Loaders(std::make_unique<naThreadPool>()) {}
+
+AssetManager::~AssetManager() {
+    m_Loaders.reset(); // finishes the queued loads
+    pRenderManager->m_Device->uploader().waitIdle(); // the pending assets may still be uploading
+}
+
+RefCounts& AssetManager::getRefCounts(AssetType type) const {
+    auto& resource = *pRenderManager->m_RenderResource;
+    return type == AssetType::mesh ? resource.getMeshRefCounts() : resource.getTextureRefCounts();
+}
+
+AssetRef AssetManager::ref(AssetType type, UID id) const {
+    auto& resource = *pRenderManager->m_RenderResource;
+    return type == AssetType::mesh ? resource.refMesh(id) : resource.refTexture(id);
+}
+
+AssetHandle AssetManager::findLoaded(AssetType type, const std::string& filename) {
+    auto& cache = getCache(type);
+    auto it = cache.files.find(filename);
+    if (it == cache.files.end()) return {};
+
+    markUsed(type, it->second.id);
+    return {ref(type, it->second.id), it->second.resident};
+}
+
+AssetRef AssetManager::loadModel(const std::string& filename) {
+    if (auto loaded = findLoaded(AssetType::mesh, filename); IsVaildUID(loaded.id))
+        return loaded.id;
+
+    auto id = pRenderManager->m_RenderResource->addMesh(naModel::createModelFromFile(*pRenderManager->m_Device, filename));
+    m_Meshes.files[filename] = {id, ready_future()};
+    m_Meshes.names[id] = filename;
+    return id;
+}
+
+AssetRef AssetManager::loadImage(const std::string& filename) {
+    if (auto loaded = findLoaded(AssetType::texture, filename); IsVaildUID(loaded.id))
+        return loaded.id;
+
+    auto id = pRenderManager->m_RenderResource->addTexture(std::make_unique<naImage>(naImage::loadImageFromFile(*pRenderManager->m_Device, filename)));
+    m_Textures.files[filename] = {id, ready_future()};
+    m_Textures.names[id] = filename;
+    return id;
+}
+
+AssetHandle AssetManager::loadModelAsync(const std::string& filename) {
+    if (auto loaded = findLoaded(AssetType::mesh, filename); IsVaildUID(loaded.id))
+        return loaded;
+
+    Pending<naModel> pending;
+    pending.id = pRenderManager->m_RenderResource->reserveMesh();
+
+    AssetHandle handle{pending.id, pending.resident.get_future().share()};
+    m_Meshes.files[filename] = {handle.id, handle.resident};
+    m_Meshes.names[handle.id] = filename;
 
-UID AssetManager::loadModel(const std::string& filename) const {
-    return pRenderManager->m_RenderResource->addMesh(naModel::createModelFromFile(*pRenderManager->m_Device, filename));
+    m_Loaders->submit([this, filename, pending = std::move(pending)]() mutable {
+        try {
+            // tinyobj parsing, vertex dedup and the bounding sphere all happen here,
+            // the buffer copies are only recorded into the upload batch
+            pending.asset = naModel::createModelFromFile(*pRenderManager->m_Device, filename);
+        } catch (...) {
+            pending.error = std::current_exception();
+        }
+        std::lock_guard lock{m_PendingMutex};
+        m_PendingModels.push_back(std::move(pending));
+    });
+
+    return handle;
+}
+
+AssetHandle AssetManager::loadImageAsync(const std::string& filename) {
+    if (auto loaded = findLoaded(AssetType::texture, filename); IsVaildUID(loaded.id))
+        return loaded;
+
+    Pending<naImage> pending;
+    pending.id = pRenderManager->m_RenderResource->reserveTexture();
+
+    AssetHandle handle{pending.id, pending.resident.get_future().share()};
+    m_Textures.files[filename] = {handle.id, handle.resident};
+    m_Textures.names[handle.id] = filename;
+
+    m_Loaders->submit([this, filename, pending = std::move(pending)]() mutable {
+        try {
+            pending.asset = std::make_unique<naImage>(naImage::loadImageFromFile(*pRenderManager->m_Device, filename));
+        } catch (...) {
+            pending.error = std::current_exception();
+        }
+        std::lock_guard lock{m_PendingMutex};
+        m_PendingImages.push_back(std::move(pending));
+    });
+
+    return handle;
+}
+
+void AssetManager::update() {
+    auto& resource = *pRenderManager->m_RenderResource;
+    auto& uploader = pRenderManager->m_Device->uploader();
+
+    {
+        std::lock_guard lock{m_PendingMutex};
+
+        std::erase_if(m_PendingModels, [&](Pending<naModel>& i) {
+            if (i.error) {
+                // a later load of the file tries again instead of getting this failure back
+                auto filename = forgetFile(AssetType::mesh, i.id.id());
+                WARNING_LOG("Failed to load model {}: {}, keep using the placeholder", filename, error_message(i.error));
+                i.resident.set_exception(i.error);
+                return true;
+            }
+            if (!uploader.isComplete(i.asset->getUploadTicket()))
+                return false;
+
+            resource.setMesh(i.id, std::move(i.asset));
+            i.resident.set_value();
+            return true;
+        });
+
+        std::erase_if(m_PendingImages, [&](Pending<naImage>& i) {
+            if (i.error) {
+                // a later load of the file tries again instead of getting this failure back
+                auto filename = forgetFile(AssetType::texture, i.id.id());
+                WARNING_LOG("Failed to load image {}: {}, keep using the placeholder", filename, error_message(i.error));
+                i.resident.set_exception(i.error);
+                return true;
+            }
+            if (!uploader.isComplete(i.asset->getUploadTicket()))
+                return false;
+
+            resource.setTexture(i.id, std::move(i.asset)); // also rewrites the set its materials share
+            i.resident.set_value();
+            return true;
+        });
+    }
+
+    unloadUnused();
 }
 
-UID AssetManager::loadImage(const std::string& filename) const {
-    return pRenderManager->m_RenderResource->addTexture(std::make_unique<naImage>(naImage::loadImageFromFile(*pRenderManager->m_Device, filename)));
+void AssetManager::markUnused(AssetType type, UID id) {
+    auto& cache = getCache(type);
+    if (auto it = cache.unused.find(id); it != cache.unused.end()) {
+        m_Unused.splice(m_Unused.end(), m_Unused, it->second); // released again, it's the most recent now
+        return;
+    }
+    cache.unused[id] = m_Unused.insert(m_Unused.end(), Unused{type, id});
 }
 
-}
\ No newline at end of file
+void AssetManager::markUsed(AssetType type, UID id) {
+    auto& cache = getCache(type);
+    if (auto it = cache.unused.find(id); it != cache.unused.end()) {
+        m_Unused.erase(it->second);
+        cache.unused.erase(it);
+    }
+}
+
+void AssetManager::unloadUnused() {
+    auto& resource = *pRenderManager->m_RenderResource;
+
+    // materials first, unloading them releases their textures
+    auto& materialRefs = resource.getMaterialRefCounts();
+    for (auto id : materialRefs.takeReleased())
+        if (materialRefs.count(id) == 0)
+            resource.removeMaterial(id);
+
+    for (auto type : {AssetType::mesh, AssetType::texture}) {
+        auto& refs = getRefCounts(type);
+        for (auto id : refs.takeReleased()) {
+            if (refs.count(id) != 0) continue;
+            // nobody can ask for an asset that wasn't loaded from a file again
+            if (getCache(type).names.contains(id))
+                markUnused(type, id);
+            else
+                unload(type, id);
+        }
+    }
+
+    while (!m_Unused.empty() && resource.getAssetMemory() > m_MemoryBudget) {
+        auto [type, id] = m_Unused.front();
+        markUsed(type, id);
+        if (getRefCounts(type).count(id) == 0) // not referenced again through a copy of the id
+            unload(type, id);
+    }
+
+    // the referenced assets alone may not fit
+    bool overBudget = resource.getAssetMemory() > m_MemoryBudget && m_MemoryBudget != 0;
+    if (overBudget && !m_OverBudgetReported)
+        WARNING_LOG("referenced assets use {} bytes, more than the budget of {}", resource.getAssetMemory(), m_MemoryBudget);
+    m_OverBudgetReported = overBudget;
+}
+
+void AssetManager::unload(AssetType type, UID id) {
+    forgetFile(type, id);
+
+    auto& resource = *pRenderManager->m_RenderResource;
+    if (type == AssetType::mesh)
+        resource.removeMesh(id);
+    else
+        resource.removeTexture(id);
+}
+
+std::string AssetManager::forgetFile(AssetType type, UID id) {
+    auto& cache = getCache(type);
+    auto it = cache.names.find(id);
+    if (it == cache.names.end()) return {};
+
+    auto filename = std::move(it->second);
+    cache.names.erase(it);
+    cache.files.erase(filename);
+    return filename;
+}
+
+}
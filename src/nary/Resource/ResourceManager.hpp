@@ -1,11 +1,21 @@
 #pragma once
 
+#include <chrono>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace nary {
 
 class RenderManager;
+class naThreadPool;
+class naModel;
+class naImage;
 
 using UID = size_t;
 constexpr UID invaild_uid = 0;
@@ -17,19 +27,26 @@ public:
     UidMap() = default;
     
     UID insert(const T& e) {
-        m_Map.emplace(++currID, e);
-        return currID;
+        auto id = nextID();
+        m_Map.emplace(id, e);
+        return id;
     }
     UID insert(T&& e) {
-        m_Map.emplace(++currID, std::move(e));
-        return currID;
+        auto id = nextID();
+        m_Map.emplace(id, std::move(e));
+        return id;
     }
+    /**
+     * the id is handed out again by a later insert
+     */
     void erase(UID id) {
-        m_Map.erase(id);
+        if (m_Map.erase(id) && IsVaildUID(id))
+            m_FreeIDs.push_back(id);
     }
     bool contains(UID id) {
         return m_Map.contains(id);
     } 
+    size_t size() const {return m_Map.size();}
 
     T& operator[](UID id) {
         return m_Map[id];
@@ -44,19 +61,183 @@ public:
     auto end() const {return m_Map.cend();}
     
 private:
+    // the most recently freed id first, keeps the ids dense (they index the material buffer and bindless slots)
+    UID nextID() {
+        if (m_FreeIDs.empty()) return ++currID;
+        auto id = m_FreeIDs.back();
+        m_FreeIDs.pop_back();
+        return id;
+    }
+
     UID currID = 0;
     std::unordered_map<UID, T> m_Map;
+    std::vector<UID> m_FreeIDs;
+};
+
+/**
+ * Reference counts of the ids of one asset type. An id whose last reference is dropped is reported by
+ * takeReleased(), the owner decides when to unload it. The default assets (id 0) are never counted.
+ */
+class RefCounts {
+public:
+    void retain(UID id);
+    void release(UID id);
+    uint32_t count(UID id) const;
+
+    /**
+     * ids that lost their last reference since the last call, they may be referenced again by now
+     */
+    std::vector<UID> takeReleased();
+
+private:
+    mutable std::mutex m_Mutex; // the loader threads hold references too
+    std::unordered_map<UID, uint32_t> m_Counts;
+    std::vector<UID> m_Released;
+};
+
+/**
+ * A counted reference to an asset, copies add a reference and destroying it drops one.
+ * It converts to the plain id, which only stays valid while a reference is held.
+ */
+class AssetRef {
+public:
+    AssetRef() = default;
+    AssetRef(std::shared_ptr<RefCounts> counts, UID id) : m_Counts(std::move(counts)), m_ID(id) {retain();}
+    AssetRef(const AssetRef& o) : m_Counts(o.m_Counts), m_ID(o.m_ID) {retain();}
+    AssetRef(AssetRef&& o) noexcept : m_Counts(std::move(o.m_Counts)), m_ID(std::exchange(o.m_ID, invaild_uid)) {}
+    AssetRef& operator=(AssetRef o) noexcept {
+        std::swap(m_Counts, o.m_Counts);
+        std::swap(m_ID, o.m_ID);
+        return *this;
+    }
+    ~AssetRef() {reset();}
+
+    void reset() {
+        if (m_Counts && IsVaildUID(m_ID)) m_Counts->release(m_ID);
+        m_Counts.reset();
+        m_ID = invaild_uid;
+    }
+
+    UID id() const {return m_ID;}
+    operator UID() const {return m_ID;}
+
+private:
+    void retain() {
+        if (m_Counts && IsVaildUID(m_ID)) m_Counts->retain(m_ID);
+    }
+
+    std::shared_ptr<RefCounts> m_Counts; // outlives the render resource if a reference does
+    UID m_ID = invaild_uid;
+};
+
+/**
+ * returned by the async loaders, `id` can be used right away and refers to a placeholder until the asset is resident
+ */
+struct AssetHandle {
+    AssetRef id;
+    std::shared_future<void> resident; // holds the exception if loading failed
+
+    bool isResident() const {
+        return resident.valid() && resident.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
 };
 
 class AssetManager {
 public:
     AssetManager(RenderManager& renderManager);
+    ~AssetManager();
+
+    AssetManager(const AssetManager&) = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
 
-    UID loadModel(const std::string& filename) const;
-    UID loadImage(const std::string& filename) const;
+    /**
+     * Loading a file that is still loaded returns the same asset, also for the async loaders.
+     */
+    AssetRef loadModel(const std::string& filename);
+    AssetRef loadImage(const std::string& filename);
+
+    /**
+     * Decode on the loader threads and upload through the batched upload queue.
+     * The default mesh / texture is rendered in place of the asset until it's resident.
+     */
+    AssetHandle loadModelAsync(const std::string& filename);
+    AssetHandle loadImageAsync(const std::string& filename);
+
+    /**
+     * GPU memory the meshes and textures may use. Assets nothing refers to stay loaded while it isn't exceeded,
+     * so loading their file again is free, and are evicted least recently released first.
+     * 0, the default, unloads them as soon as their last reference is dropped.
+     */
+    void setMemoryBudget(size_t bytes) {m_MemoryBudget = bytes;}
+    size_t getMemoryBudget() const {return m_MemoryBudget;}
+
+    /**
+     * call it once per frame on the render thread, installs every asset whose upload has finished
+     * and unloads the ones nothing refers to anymore
+     */
+    void update();
 
 private:
+    template <class T>
+    struct Pending {
+        AssetRef id; // the asset stays loaded at least until it is installed
+        std::unique_ptr<T> asset;
+        std::exception_ptr error;
+        std::promise<void> resident;
+    };
+
+    enum class AssetType {
+        mesh,
+        texture
+    };
+
+    struct Unused {
+        AssetType type;
+        UID id;
+    };
+
+    struct LoadedFile {
+        UID id;
+        std::shared_future<void> resident;
+    };
+
+    struct AssetCache {
+        std::unordered_map<std::string, LoadedFile> files;
+        std::unordered_map<UID, std::string> names;
+        std::unordered_map<UID, std::list<Unused>::iterator> unused; // their place in m_Unused
+    };
+
+    AssetCache& getCache(AssetType type) {return type == AssetType::mesh ? m_Meshes : m_Textures;}
+    RefCounts& getRefCounts(AssetType type) const;
+    AssetRef ref(AssetType type, UID id) const;
+    /**
+     * a handle to the asset loaded from the file, an empty one if it isn't loaded
+     */
+    AssetHandle findLoaded(AssetType type, const std::string& filename);
+
+    void markUnused(AssetType type, UID id);
+    void markUsed(AssetType type, UID id);
+    void unloadUnused();
+    void unload(AssetType type, UID id);
+    /**
+     * drops the file the asset was loaded from, so loading it again reads the file, returns its name
+     */
+    std::string forgetFile(AssetType type, UID id);
+
     RenderManager* pRenderManager;
+
+    // kept apart from the render workers, so long decodes never delay command recording
+    std::unique_ptr<naThreadPool> m_Loaders;
+
+    std::mutex m_PendingMutex;
+    std::vector<Pending<naModel>> m_PendingModels; // decoded, waiting for upload
+    std::vector<Pending<naImage>> m_PendingImages;
+
+    AssetCache m_Meshes;
+    AssetCache m_Textures;
+    std::list<Unused> m_Unused; // least recently released first
+    size_t m_MemoryBudget = 0;
+    bool m_OverBudgetReported = false; // until the memory fits again
 };
 
 }
\ No newline at end of file
@@ -7,9 +7,14 @@
 
 #include "naUISystem.hpp"
 #include "naFrameBuffer.hpp"
+#include "naGpuProfiler.hpp"
+#include "naProfiler.hpp"
 
 #include "cpix_font.h"
 
+#include <algorithm>
+#include <cstdio>
+
 namespace nary {
 
 naUISystem::naUISystem(naDevice& device, VkRenderPass renderPass, naWin& window) : device(device), window(window) {
@@ -88,13 +93,13 @@ void naUISystem::initImGui(VkRenderPass renderPass) {
     info.PhysicalDevice = device.physicalDevice();
     info.ImageCount = naSwapChain::MAX_FRAMES_IN_FLIGHT;
     info.MsaaSamples = VK_SAMPLE_COUNT_1_BIT; // it will directly render to the swapchain
+    info.PipelineCache = device.pipelineCache();
     ImGui_ImplVulkan_Init(&info);
     
     auto commandBuffer = device.beginSingleTimeCommands();
     ImGui_ImplVulkan_CreateFontsTexture(commandBuffer);
+    // waits for the graphics queue, the staging buffer is unused afterwards
     device.endSingleTimeCommands(commandBuffer);
-    
-    vkDeviceWaitIdle(device.device());
     ImGui_ImplVulkan_DestroyFontUploadObjects();
 }
 
@@ -109,4 +114,79 @@ void naUISystem::endFrame(VkCommandBuffer commandBuffer) {
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer, 0, nullptr);
 }
 
+void naUISystem::drawGpuProfiler(const naGpuProfiler& profiler) {
+    ImGui::Begin("GPU Profiler");
+
+    if (!profiler.isSupported()) {
+        ImGui::Text("timestamp queries are not supported");
+        ImGui::End();
+        return;
+    }
+
+    auto& latest = profiler.getLatest();
+    ImGui::Text("frame %llu", static_cast<unsigned long long>(latest.frame));
+    for (auto& zone : latest.zones) {
+        ImGui::Text("%*s%-14s %7.3f ms", static_cast<int>(zone.depth * 2), "", zone.name, zone.ms);
+    }
+
+    // the outermost zones make up the frame time
+    std::vector<float> frameTimes;
+    frameTimes.reserve(profiler.getHistory().size());
+    for (auto& frame : profiler.getHistory()) {
+        float ms = 0;
+        for (auto& zone : frame.zones)
+            if (zone.depth == 0) ms += static_cast<float>(zone.ms);
+        frameTimes.push_back(ms);
+    }
+    ImGui::PlotLines("##frame", frameTimes.data(), static_cast<int>(frameTimes.size()), 0, "GPU ms", 0.f, FLT_MAX, {0, 60});
+
+    static char filename[128] = "gpu_profile.csv";
+    ImGui::InputText("##file", filename, sizeof(filename));
+    ImGui::SameLine();
+    if (ImGui::Button("Export CSV"))
+        profiler.exportCSV(filename);
+
+    ImGui::End();
+}
+
+void naUISystem::drawCpuProfiler() {
+#if NARY_PROFILE
+    ImGui::Begin("CPU Profiler");
+
+    static int frames = 60;
+    static char filename[128] = "cpu_trace.json";
+    ImGui::InputInt("Frames", &frames);
+    ImGui::InputText("##file", filename, sizeof(filename));
+    ImGui::SameLine();
+    if (naProfiler::isCapturing())
+        ImGui::Text("capturing...");
+    else if (ImGui::Button("Capture"))
+        naProfiler::beginCapture(static_cast<uint32_t>(std::max(frames, 1)), filename);
+
+    ImGui::End();
+#endif
+}
+
+void naUISystem::drawMemoryStats() {
+    ImGui::Begin("GPU Memory");
+
+    constexpr float MiB = 1024.f * 1024.f;
+    if (!device.hasMemoryBudget())
+        ImGui::Text("VK_EXT_memory_budget unsupported, budgets are estimated");
+    auto stats = device.getMemoryStats();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        auto& heap = stats[i];
+        ImGui::Text("heap %zu%s, %.0f MiB", i, heap.deviceLocal ? " (device local)" : "", heap.size / MiB);
+        float used = heap.budget ? static_cast<float>(heap.usage) / heap.budget : 0.f;
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.1f / %.1f MiB", heap.usage / MiB, heap.budget / MiB);
+        ImGui::ProgressBar(std::min(used, 1.f), {-1, 0}, overlay);
+        ImGui::Text("  %u blocks %.1f MiB, %u allocations %.1f MiB, %.1f%% unused",
+                    heap.blockCount, heap.blockBytes / MiB, heap.allocationCount, heap.allocationBytes / MiB,
+                    heap.fragmentation() * 100.f);
+    }
+
+    ImGui::End();
+}
+
 }
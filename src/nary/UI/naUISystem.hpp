@@ -18,6 +18,8 @@
 
 namespace nary {
 
+class naGpuProfiler;
+
 class naUISystem {
 public:
     naUISystem(naDevice& device, VkRenderPass renderPass, naWin& window);
@@ -27,6 +29,21 @@ public:
     
     void beginFrame();
     void endFrame(VkCommandBuffer commandBuffer);
+
+    /**
+     * panel with the GPU time of every zone and the frame time graph
+     */
+    void drawGpuProfiler(const naGpuProfiler& profiler);
+
+    /**
+     * capture the next frames into a Chrome trace, a no-op when profiling is compiled out
+     */
+    void drawCpuProfiler();
+
+    /**
+     * budget, usage and fragmentation of every memory heap
+     */
+    void drawMemoryStats();
     
 private:
     naDevice& device;